@@ -0,0 +1,203 @@
+#ifndef AFFINITY_HPP_INCLUDED
+#define AFFINITY_HPP_INCLUDED
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace affinity {
+enum class policy_t { none, compact, scatter };
+
+struct cpu_t {
+    uint id;
+    int core;
+    int package;
+    int node;
+};
+
+inline policy_t parse_policy(std::string_view name)
+{
+    if (name == "none") {
+        return policy_t::none;
+    }
+    if (name == "compact") {
+        return policy_t::compact;
+    }
+    if (name == "scatter") {
+        return policy_t::scatter;
+    }
+    throw std::invalid_argument{"Unknown pin policy : " + std::string{name}};
+}
+
+// разбирает списки вида "0-3,8,10-11" из /sys
+inline std::vector<uint> parse_cpu_list(const std::string& list)
+{
+    std::vector<uint> result{};
+    std::istringstream stream{list};
+    for (std::string range; std::getline(stream, range, ',');) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const auto dash = range.find('-');
+        const auto first = static_cast<uint>(std::stoul(range.substr(0, dash)));
+        const auto last = dash == std::string::npos
+            ? first
+            : static_cast<uint>(std::stoul(range.substr(dash + 1)));
+        for (auto cpu = first; cpu <= last; ++cpu) {
+            result.push_back(cpu);
+        }
+    }
+    return result;
+}
+
+namespace detail {
+inline std::string read_line(const std::filesystem::path& path)
+{
+    std::ifstream in{path};
+    std::string line{};
+    std::getline(in, line);
+    return line;
+}
+
+inline int read_int(const std::filesystem::path& path, int default_value)
+{
+    const auto line = read_line(path);
+    return line.empty() ? default_value : std::stoi(line);
+}
+
+inline bool is_allowed(uint cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return true;
+    }
+    return CPU_ISSET(cpu, &set);
+#else
+    (void)cpu;
+    return true;
+#endif
+}
+} // namespace detail
+
+// доступные процессу логические процессоры с ядром, сокетом и NUMA-узлом
+inline std::vector<cpu_t> read_topology()
+{
+    namespace fs = std::filesystem;
+    const fs::path cpu_root{"/sys/devices/system/cpu"};
+    const fs::path node_root{"/sys/devices/system/node"};
+
+    std::map<uint, int> node_of_cpu{};
+    if (fs::exists(node_root)) {
+        for (const auto& entry : fs::directory_iterator{node_root}) {
+            const auto name = entry.path().filename().string();
+            if (name.rfind("node", 0) != 0 || name.size() == 4
+                || !std::isdigit(static_cast<unsigned char>(name[4]))) {
+                continue;
+            }
+            const auto node = std::stoi(name.substr(4));
+            for (const auto cpu : parse_cpu_list(detail::read_line(entry.path() / "cpulist"))) {
+                node_of_cpu[cpu] = node;
+            }
+        }
+    }
+
+    std::vector<cpu_t> result{};
+    for (const auto id : parse_cpu_list(detail::read_line(cpu_root / "online"))) {
+        if (!detail::is_allowed(id)) {
+            continue;
+        }
+        const auto topology = cpu_root / ("cpu" + std::to_string(id)) / "topology";
+        const auto node = node_of_cpu.count(id) ? node_of_cpu[id] : 0;
+        result.push_back(
+            {id,
+             detail::read_int(topology / "core_id", static_cast<int>(id)),
+             detail::read_int(topology / "physical_package_id", 0),
+             node});
+    }
+    return result;
+}
+
+// порядок, в котором потоки занимают процессоры.
+// Сначала берётся по одному логическому процессору на физическое ядро, SMT-соседи идут в конце.
+// compact заполняет узел за узлом, scatter раскладывает потоки по узлам по очереди.
+inline std::vector<uint> make_pinning_order(std::vector<cpu_t> cpus, policy_t policy)
+{
+    if (policy == policy_t::none || cpus.empty()) {
+        return {};
+    }
+    std::sort(cpus.begin(), cpus.end(), [](const cpu_t& lhs, const cpu_t& rhs) {
+        return std::tie(lhs.node, lhs.package, lhs.core, lhs.id)
+            < std::tie(rhs.node, rhs.package, rhs.core, rhs.id);
+    });
+    std::vector<cpu_t> primary{};
+    std::vector<cpu_t> siblings{};
+    for (const auto& cpu : cpus) {
+        const bool is_sibling = !primary.empty() && primary.back().node == cpu.node
+            && primary.back().package == cpu.package && primary.back().core == cpu.core;
+        (is_sibling ? siblings : primary).push_back(cpu);
+    }
+
+    auto arrange = [policy](const std::vector<cpu_t>& group) {
+        std::vector<uint> order{};
+        if (policy == policy_t::compact) {
+            for (const auto& cpu : group) {
+                order.push_back(cpu.id);
+            }
+            return order;
+        }
+        std::map<int, std::vector<uint>> by_node{};
+        for (const auto& cpu : group) {
+            by_node[cpu.node].push_back(cpu.id);
+        }
+        for (auto round = 0u; order.size() < group.size(); ++round) {
+            for (const auto& [node, ids] : by_node) {
+                if (round < ids.size()) {
+                    order.push_back(ids[round]);
+                }
+            }
+        }
+        return order;
+    };
+    auto order = arrange(primary);
+    const auto sibling_order = arrange(siblings);
+    order.insert(order.end(), sibling_order.begin(), sibling_order.end());
+    return order;
+}
+
+inline int node_of(const std::vector<cpu_t>& cpus, uint id)
+{
+    const auto iter
+        = std::find_if(cpus.begin(), cpus.end(), [id](const cpu_t& cpu) { return cpu.id == id; });
+    return iter == cpus.end() ? -1 : iter->node;
+}
+
+inline bool pin_current_thread(uint cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+} // namespace affinity
+
+#endif
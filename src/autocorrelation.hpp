@@ -0,0 +1,47 @@
+#ifndef AUTOCORRELATION_HPP_INCLUDED
+#define AUTOCORRELATION_HPP_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+namespace stat {
+// Интегральное время автокорреляции ряда в шагах: 1/2 + сумма нормированной автокорреляции
+// по сдвигам t до окна M - первого сдвига, для которого M >= window_factor * tau(M) (окно Сокала).
+// Для ряда короче двух значений или постоянного ряда - 1/2, то есть значения независимы
+inline double getAutocorrelationTime(const std::vector<double>& series, double window_factor = 6.0)
+{
+    const auto size = series.size();
+    if (size < 2) {
+        return 0.5;
+    }
+    double mean = 0.0;
+    for (const auto value : series) {
+        mean += value;
+    }
+    mean /= static_cast<double>(size);
+    double variance = 0.0;
+    for (const auto value : series) {
+        variance += (value - mean) * (value - mean);
+    }
+    variance /= static_cast<double>(size);
+    if (variance <= 0.0) {
+        return 0.5;
+    }
+
+    double tau = 0.5;
+    for (std::size_t lag = 1; lag < size; ++lag) {
+        double covariance = 0.0;
+        for (std::size_t idx = 0; idx + lag < size; ++idx) {
+            covariance += (series[idx] - mean) * (series[idx + lag] - mean);
+        }
+        covariance /= static_cast<double>(size - lag);
+        tau += covariance / variance;
+        if (static_cast<double>(lag) >= window_factor * tau) {
+            break;
+        }
+    }
+    return tau;
+}
+} // namespace stat
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef CHECKPOINT_HPP_INCLUDED
+#define CHECKPOINT_HPP_INCLUDED
+
+#include "config.hpp"
+#include "progress.hpp"
+#include "system.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <valarray>
+#include <vector>
+
+namespace task {
+struct checkpoint_exception : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+class binary_writer_t {
+    std::ofstream out;
+
+public:
+    explicit binary_writer_t(const std::filesystem::path& path)
+        : out{path, std::ios::binary | std::ios::trunc}
+    {
+        if (!out) {
+            throw checkpoint_exception{"Can not open " + path.string() + " for writing"};
+        }
+    }
+
+    template<typename T>
+    binary_writer_t& write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        return *this;
+    }
+    binary_writer_t& write(const std::string& value)
+    {
+        write(static_cast<std::uint64_t>(value.size()));
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+        return *this;
+    }
+    binary_writer_t& write(const std::valarray<double>& value)
+    {
+        write(static_cast<std::uint64_t>(value.size()));
+        for (const auto elem : value) {
+            write(elem);
+        }
+        return *this;
+    }
+    binary_writer_t& write(const base_config::magn_t& value)
+    {
+        return write(value.x).write(value.y).write(value.z);
+    }
+
+    void close()
+    {
+        out.flush();
+        if (!out) {
+            throw checkpoint_exception{"Checkpoint write failed"};
+        }
+        out.close();
+    }
+};
+
+class binary_reader_t {
+    std::ifstream in;
+
+public:
+    explicit binary_reader_t(const std::filesystem::path& path)
+        : in{path, std::ios::binary}
+    {
+        if (!in) {
+            throw checkpoint_exception{"Can not open " + path.string()};
+        }
+    }
+
+    template<typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value{};
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        if (!in) {
+            throw checkpoint_exception{"Unexpected end of checkpoint"};
+        }
+        return value;
+    }
+    std::string read_string()
+    {
+        std::string value(read<std::uint64_t>(), '\0');
+        in.read(value.data(), static_cast<std::streamsize>(value.size()));
+        if (!in) {
+            throw checkpoint_exception{"Unexpected end of checkpoint"};
+        }
+        return value;
+    }
+    std::valarray<double> read_valarray()
+    {
+        std::valarray<double> value(read<std::uint64_t>());
+        for (auto& elem : value) {
+            elem = read<double>();
+        }
+        return value;
+    }
+    base_config::magn_t read_magn()
+    {
+        const auto x = read<double>();
+        const auto y = read<double>();
+        const auto z = read<double>();
+        return {x, y, z};
+    }
+};
+
+// состояние спиновой решётки: температура, намагниченности плёнок и все спины
+template<typename Lattice>
+void writeLatticeState(binary_writer_t& writer, const Lattice& lattice)
+{
+    writer.write(lattice.T);
+    writer.write(static_cast<std::uint64_t>(lattice.nanostructure.size()));
+    for (auto idx = 0u; idx < lattice.nanostructure.size(); ++idx) {
+        writer.write(lattice.magns[idx]);
+    }
+    for (const auto& film : lattice.nanostructure) {
+        writer.write(static_cast<std::uint64_t>(film.get_amount_of_nodes()));
+        for (const auto& spin : film) {
+            writer.write(spin.x).write(spin.y).write(spin.z);
+        }
+    }
+}
+
+template<typename Lattice>
+void readLatticeState(binary_reader_t& reader, Lattice& lattice)
+{
+    lattice.T = reader.read<double>();
+    if (reader.read<std::uint64_t>() != lattice.nanostructure.size()) {
+        throw checkpoint_exception{"Amount of films does not match"};
+    }
+    for (auto idx = 0u; idx < lattice.nanostructure.size(); ++idx) {
+        lattice.magns[idx] = reader.read_magn();
+    }
+    for (auto& film : lattice.nanostructure) {
+        if (reader.read<std::uint64_t>() != film.get_amount_of_nodes()) {
+            throw checkpoint_exception{"Film size does not match"};
+        }
+        for (auto& spin : film) {
+            const auto x = reader.read<double>();
+            const auto y = reader.read<double>();
+            const auto z = reader.read<double>();
+            spin = base_config::spin_t{x, y, z};
+        }
+    }
+}
+
+// mcs - первый ещё не выполненный шаг фазы,
+// file_offsets - длины выходных файлов в байтах на момент сохранения
+struct checkpoint_t {
+    phase_t phase = phase_t::prepare;
+    std::uint64_t mcs = 0;
+    std::valarray<double> j_up_arr{};
+    std::valarray<double> j_down_arr{};
+    std::vector<std::pair<std::string, std::uint64_t>> file_offsets{};
+};
+
+namespace detail {
+constexpr std::array<char, 8> checkpoint_magic{'G', 'M', 'R', 'C', 'K', 'P', 'T', '\0'};
+constexpr std::uint32_t checkpoint_version = 3;
+
+inline void writeConfig(binary_writer_t& writer, const base_config::config_t& config)
+{
+    writer.write(base_config::L)
+        .write(config.stat_id)
+        .write(config.N)
+        .write(config.T_creation)
+        .write(config.T_sample)
+        .write(config.field);
+}
+
+inline bool isSameConfig(binary_reader_t& reader, const base_config::config_t& config)
+{
+    const auto L = reader.read<std::uint16_t>();
+    const auto stat_id = reader.read<std::uint16_t>();
+    const auto N = reader.read<std::uint8_t>();
+    const auto T_creation = reader.read<double>();
+    const auto T_sample = reader.read<double>();
+    const auto field = reader.read_magn();
+    return L == base_config::L && stat_id == config.stat_id && N == config.N && T_creation == config.T_creation
+        && T_sample == config.T_sample && is_almost_equals(field, config.field);
+}
+
+template<typename Multilayer>
+void writeDencity(binary_writer_t& writer, const std::vector<Multilayer>& replicas)
+{
+    for (const auto& replica : replicas) {
+        for (const auto& film : replica) {
+            for (const auto& elem : film) {
+                writer.write(static_cast<double>(elem));
+            }
+        }
+    }
+}
+
+template<typename Multilayer>
+void readDencity(binary_reader_t& reader, std::vector<Multilayer>& replicas)
+{
+    for (auto& replica : replicas) {
+        for (auto& film : replica) {
+            for (auto& elem : film) {
+                elem = base_config::ed_t{reader.read<double>()};
+            }
+        }
+    }
+}
+} // namespace detail
+
+// Генератор случайных чисел принадлежит qss и недоступен снаружи, поэтому его состояние
+// не сохраняется: после восстановления траектория статистически эквивалентна, но не побитово.
+// Своих генераторов у шагов динамической стадии и наблюдения нет: проход по решётке - только
+// evolve из qss. Генератор обмена реплик (tempering.hpp) живёт лишь при подготовке, а она
+// в контрольной точке не сохраняется и после остановки считается заново. Если у шагов после
+// подготовки появится своё случайное состояние, его нужно писать сюда и поднимать версию.
+// Прокси-решётки транспорта строятся поверх n_up_vec/n_down_vec, поэтому достаточно сохранить
+// электронную плотность реплик. Файл пишется во временный и переименовывается.
+template<typename Sample>
+std::uintmax_t writeCheckpoint(
+    const std::filesystem::path& path,
+    const base_config::config_t& config,
+    const checkpoint_t& checkpoint,
+    const Sample& sample)
+{
+    auto temp_path = path;
+    temp_path += ".tmp";
+    {
+        binary_writer_t writer{temp_path};
+        writer.write(detail::checkpoint_magic).write(detail::checkpoint_version);
+        detail::writeConfig(writer, config);
+        writer.write(checkpoint.phase).write(checkpoint.mcs);
+        writer.write(checkpoint.j_up_arr).write(checkpoint.j_down_arr);
+        writer.write(static_cast<std::uint64_t>(checkpoint.file_offsets.size()));
+        for (const auto& [name, offset] : checkpoint.file_offsets) {
+            writer.write(name).write(offset);
+        }
+
+        writeLatticeState(writer, sample.lattice);
+        for (const auto& elem : sample.N_up_values_arr) {
+            writer.write(elem);
+        }
+        for (const auto& elem : sample.N_down_values_arr) {
+            writer.write(elem);
+        }
+        detail::writeDencity(writer, sample.n_up_vec);
+        detail::writeDencity(writer, sample.n_down_vec);
+        writer.close();
+    }
+    std::filesystem::rename(temp_path, path);
+    return std::filesystem::file_size(path);
+}
+
+// восстанавливает состояние образца, созданного createSample для той же конфигурации
+template<typename Sample>
+checkpoint_t readCheckpoint(
+    const std::filesystem::path& path, const base_config::config_t& config, Sample& sample)
+{
+    binary_reader_t reader{path};
+    if (reader.read<std::array<char, 8>>() != detail::checkpoint_magic
+        || reader.read<std::uint32_t>() != detail::checkpoint_version) {
+        throw checkpoint_exception{path.string() + " is not a checkpoint of this version"};
+    }
+    if (!detail::isSameConfig(reader, config)) {
+        throw checkpoint_exception{path.string() + " belongs to another config"};
+    }
+    checkpoint_t checkpoint{};
+    checkpoint.phase = reader.read<phase_t>();
+    checkpoint.mcs = reader.read<std::uint64_t>();
+    checkpoint.j_up_arr = reader.read_valarray();
+    checkpoint.j_down_arr = reader.read_valarray();
+    const auto files_amount = reader.read<std::uint64_t>();
+    for (auto idx = 0u; idx < files_amount; ++idx) {
+        auto name = reader.read_string();
+        const auto offset = reader.read<std::uint64_t>();
+        checkpoint.file_offsets.emplace_back(std::move(name), offset);
+    }
+
+    readLatticeState(reader, sample.lattice);
+    for (auto& elem : sample.N_up_values_arr) {
+        elem = reader.read_valarray();
+    }
+    for (auto& elem : sample.N_down_values_arr) {
+        elem = reader.read_valarray();
+    }
+    detail::readDencity(reader, sample.n_up_vec);
+    detail::readDencity(reader, sample.n_down_vec);
+    return checkpoint;
+}
+} // namespace task
+
+#endif
@@ -13,8 +13,11 @@
 #include "utility/functions.hpp"
 #include "utility/quantities.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <iterator>
+#include <numeric>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -55,8 +58,8 @@ struct base_config {
     };
 
     base_config() = delete;
-    // линейный размер
-    constexpr static std::uint16_t L = 64;
+    // линейные размеры, для которых собраны конкретизации расчёта
+    constexpr static std::array<std::uint16_t, 4> L_menu{32, 64, 128, 256};
     // обменный интеграл взаимодействия плёнок
     constexpr static double J2 = -0.05;
     constexpr static std::array<double, 10> deltas{
@@ -65,16 +68,21 @@ struct base_config {
     {
         return deltas[--N];
     }
-    constexpr static std::uint16_t m_stat_amount = 10; // количество статистических прогонок
-    constexpr static std::uint16_t j_stat_amount = 50;
-    constexpr static std::uint64_t mcs_init = 500;
-    constexpr static std::uint64_t mcs_observation = 5'000;
-    constexpr static std::array N_size_vec{3u, 5u, 7u};
-    constexpr static std::array T_creation_vec{0.67};
-    constexpr static std::array T_sample_vec{0.95};
-    constexpr static std::array t_wait_vec{
+    // параметры развёртки: значения по умолчанию заменяются файлом развёртки (см. sweep.hpp)
+    // при запуске, до создания потоков, и дальше только читаются
+    // линейный размер, одно из L_menu
+    inline static std::uint16_t L = 64;
+    inline static std::uint16_t m_stat_amount = 10; // количество статистических прогонок
+    inline static std::uint16_t j_stat_amount = 50;
+    inline static std::uint64_t mcs_init = 500;
+    inline static std::uint64_t mcs_observation = 5'000;
+    inline static std::vector<unsigned> N_size_vec{3u, 5u, 7u};
+    inline static std::vector<double> T_creation_vec{0.67};
+    inline static std::vector<double> T_sample_vec{0.95};
+    // у каждого t_wait свой набор из j_stat_amount реплик транспорта на одной траектории спинов
+    inline static std::vector<unsigned> t_wait_vec{
         0u}; //, 100U, 200u, 400u, 1000u}; // должен быть отсортирован по увеличению
-    constexpr static std::array magn_field_vec{
+    inline static std::vector<magn_t> magn_field_vec{
         magn_t{0.0, 0.0, 0.0},
         magn_t{0.3, 0.0, 0.0},
         magn_t{0.4, 0.0, 0.0},
@@ -88,6 +96,12 @@ struct base_config {
 
     constexpr static double A_fb = -0.8;
 
+    // реплик транспорта в конфигурации: наборы по j_stat_amount для каждого t_wait подряд
+    static std::size_t getReplicasAmount() noexcept
+    {
+        return std::size_t{j_stat_amount} * t_wait_vec.size();
+    }
+
     constexpr static auto createHamilton_f(const magn_t& h, double Delta)
     {
         return [&h, Delta](
@@ -140,7 +154,8 @@ inline std::string create_config_info()
 {
     std::ostringstream stream{};
     stream
-        << "base_config : \n[\n\t m_stat_amount : " << base_config::m_stat_amount
+        << "base_config : \n[\n\t L : " << base_config::L
+        << "\n\t m_stat_amount : " << base_config::m_stat_amount
         << "\n\t j_stat_amount : " << base_config::j_stat_amount
         << "\n\t mcs_init : " << base_config::mcs_init
         << "\n\t mcs_observation : " << base_config::mcs_observation << "\n\t N_size_vec : ["
@@ -157,6 +172,67 @@ inline std::string create_config_info()
     return stream.str();
 }
 
+// относительная трудоёмкость расчёта конфигурации: число узлов на число шагов Монте-Карло
+// и на число расчётов спинового транспорта - mcs_observation шагов каждого набора реплик
+inline double estimateCost(const base_config::config_t& config) noexcept
+{
+    const auto volume = static_cast<double>(base_config::L) * base_config::L * config.N;
+    const auto mcs_amount = static_cast<double>(
+        base_config::mcs_init + base_config::mcs_observation + base_config::t_wait_vec.back());
+    const auto transport_amount = static_cast<double>(
+        base_config::mcs_observation * base_config::getReplicasAmount());
+    return volume * (mcs_amount + transport_amount);
+}
+
+// оценка пиковой памяти расчёта конфигурации в байтах: две плёнки спинов, по паре
+// мультислоёв электронной плотности и прокси-решётке на каждую реплику транспорта
+// (по 4 узла на ячейку ГЦК), плюс буферы трёх файлов на реплику и ещё 10 открытых файлов
+inline std::size_t estimateMemory(const base_config::config_t& config) noexcept
+{
+    constexpr std::size_t films_amount = 2;
+    constexpr std::size_t fcc_nodes_per_cell = 4;
+    constexpr std::size_t stream_buffer_size = 8 * 1024;
+    const auto nodes
+        = films_amount * fcc_nodes_per_cell * base_config::L * base_config::L * config.N;
+    const auto node_size = sizeof(base_config::spin_t)
+        + base_config::getReplicasAmount()
+            * (2 * sizeof(base_config::ed_t) + sizeof(qss::spin_transport::proxy_spin));
+    const auto files_amount = 3 * base_config::getReplicasAmount() + 10;
+    return nodes * node_size + files_amount * stream_buffer_size;
+}
+
+// доля shard_idx из shards_amount: самые трудоёмкие конфигурации по очереди отдаются наименее
+// загруженной доле (при равенстве - с меньшим номером). Результат зависит только от списка
+// конфигураций, поэтому на всех узлах разбиение одинаковое
+inline std::vector<base_config::config_t> selectShard(
+    const std::vector<base_config::config_t>& configs,
+    std::size_t shard_idx,
+    std::size_t shards_amount)
+{
+    std::vector<std::size_t> order(configs.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&configs](std::size_t lhs, std::size_t rhs) {
+        return estimateCost(configs[lhs]) > estimateCost(configs[rhs]);
+    });
+
+    std::vector<double> loads(shards_amount, 0.0);
+    std::vector<bool> is_selected(configs.size(), false);
+    for (const auto idx : order) {
+        const auto lightest = static_cast<std::size_t>(
+            std::distance(loads.begin(), std::min_element(loads.begin(), loads.end())));
+        loads[lightest] += estimateCost(configs[idx]);
+        is_selected[idx] = lightest == shard_idx;
+    }
+
+    std::vector<base_config::config_t> result{};
+    for (auto idx = 0u; idx < configs.size(); ++idx) {
+        if (is_selected[idx]) {
+            result.push_back(configs[idx]);
+        }
+    }
+    return result;
+}
+
 inline std::string createName(const base_config::config_t& config) noexcept
 {
     using std::to_string;
@@ -166,6 +242,16 @@ inline std::string createName(const base_config::config_t& config) noexcept
     return stream.str();
 }
 
+// имя файлов набора реплик транспорта с ожиданием t_wait без номера реплики, например j_tw=100.
+// При единственном t_wait имена остаются прежними (j, Nup, Ndown, P, P_mod), их ждёт plotter.py
+inline std::string createTransportName(std::string_view name, unsigned t_wait)
+{
+    if (base_config::t_wait_vec.size() == 1) {
+        return std::string{name};
+    }
+    return std::string{name} + "_tw=" + std::to_string(t_wait);
+}
+
 inline std::ostream& operator<<(std::ostream& out, const base_config::config_t& data) noexcept
 {
     using std::to_string;
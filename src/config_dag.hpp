@@ -0,0 +1,268 @@
+#ifndef CONFIG_DAG_HPP_INCLUDED
+#define CONFIG_DAG_HPP_INCLUDED
+
+#include "config.hpp"
+#include "lattice_access.hpp"
+
+#include <algorithm>
+#include <any>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+namespace task {
+// Граф конфигураций с общей подготовкой. Узел - конфигурации с общими (N, T_creation, stat_id, h),
+// они различаются только T_sample, первая по T_sample - ведущая. Подготовленная решётка
+// публикуется первой конфигурацией узла, закончившей подготовку, и передаётся по рёбрам:
+//  - fork: ведомые конфигурации узла не готовят образец, а копируют решётку ведущей,
+//    поэтому подготовка считается один раз на узел;
+//  - continuation: узлы с общими (N, T_creation, stat_id) образуют цепочку по |h|, и подготовка
+//    следующего узла начинается с копии решётки предыдущего, а не с createSample.
+// Конфигурации ставятся в пул, только когда решётка, от которой они стартуют, опубликована,
+// поэтому потоки пула не ждут друг друга. Если источник закончился, ничего не опубликовав
+// (отмена или продолжение после подготовки), зависящие от него конфигурации готовятся сами
+class config_dag_t {
+public:
+    using submit_f = std::function<void(const base_config::config_t&)>;
+
+    // откуда взята решётка: копия ведущей конфигурации узла или предыдущего поля цепочки
+    struct start_t {
+        enum class kind_t { fork, continuation } kind;
+        base_config::magn_t field;
+        double T_sample;
+        std::uint64_t init_mcs;
+    };
+
+    config_dag_t(
+        const std::vector<base_config::config_t>& configs, bool is_forked, bool is_continued)
+        : m_is_forked{is_forked}
+        , m_is_continued{is_continued}
+    {
+        std::map<chain_key_t, std::vector<node_key_t>> chains{};
+        for (const auto& config : configs) {
+            const auto key = nodeKey(config);
+            auto [iter, is_new] = m_nodes.try_emplace(key, node_t{config.field});
+            iter->second.configs.push_back(config);
+            if (is_new) {
+                chains[chainKey(config)].push_back(key);
+            }
+        }
+        for (auto& [key, node] : m_nodes) {
+            // config_t нельзя присваивать, поэтому ведущая ищется, а не ставится в начало
+            node.leader = static_cast<std::size_t>(
+                std::min_element(
+                    node.configs.begin(),
+                    node.configs.end(),
+                    [](const auto& lhs, const auto& rhs) { return lhs.T_sample < rhs.T_sample; })
+                - node.configs.begin());
+        }
+        if (!m_is_continued) {
+            return;
+        }
+        for (auto& [chain_key, node_keys] : chains) {
+            std::stable_sort(
+                node_keys.begin(), node_keys.end(), [this](const auto& lhs, const auto& rhs) {
+                    return abs(m_nodes.at(lhs).field) < abs(m_nodes.at(rhs).field);
+                });
+            for (auto idx = 1u; idx < node_keys.size(); ++idx) {
+                m_nodes.at(node_keys[idx]).prev = node_keys[idx - 1];
+                m_nodes.at(node_keys[idx - 1]).next = node_keys[idx];
+            }
+        }
+    }
+    config_dag_t(const config_dag_t&) = delete;
+    config_dag_t& operator=(const config_dag_t&) = delete;
+
+    void set_submit(submit_f submit)
+    {
+        m_submit = std::move(submit);
+    }
+
+    // конфигурации, которые ни от кого не зависят, остальные ставит сам граф
+    std::vector<base_config::config_t> getHeads()
+    {
+        std::lock_guard lg{m_mutex};
+        std::vector<base_config::config_t> heads{};
+        for (auto& [key, node] : m_nodes) {
+            if (!node.prev) {
+                releaseNode(node, heads);
+            }
+        }
+        return heads;
+    }
+
+    // копирует в lattice решётку, от которой стартует config, если она опубликована;
+    // копия поэлементная, хранилище спинов lattice остаётся на месте
+    template<typename Lattice>
+    std::optional<start_t> takeStart(const base_config::config_t& config, Lattice& lattice) const
+    {
+        std::lock_guard lg{m_mutex};
+        const auto& node = m_nodes.at(nodeKey(config));
+        if (m_is_forked && !isLeader(node, config)) {
+            if (const auto* state = std::any_cast<Lattice>(&node.state); state != nullptr) {
+                copyLatticeState(*state, lattice);
+                return start_t{
+                    start_t::kind_t::fork, node.field, node.published_T_sample, node.init_mcs};
+            }
+        }
+        if (node.prev) {
+            const auto& prev = m_nodes.at(*node.prev);
+            if (const auto* state = std::any_cast<Lattice>(&prev.state); state != nullptr) {
+                copyLatticeState(*state, lattice);
+                return start_t{
+                    start_t::kind_t::continuation,
+                    prev.field,
+                    prev.published_T_sample,
+                    prev.init_mcs};
+            }
+        }
+        return std::nullopt;
+    }
+
+    // решётка config подготовлена, init_mcs - счётчик "Initialization stage duration" её
+    // подготовки. Первая опубликованная в узле запускает ведомые конфигурации узла и следующий
+    // узел цепочки
+    template<typename Lattice>
+    void publish(
+        const base_config::config_t& config, const Lattice& lattice, std::uint64_t init_mcs)
+    {
+        std::vector<base_config::config_t> released{};
+        {
+            std::lock_guard lg{m_mutex};
+            auto& node = m_nodes.at(nodeKey(config));
+            if (node.is_published) {
+                return;
+            }
+            node.is_published = true;
+            if ((m_is_forked && node.configs.size() > 1) || node.next) {
+                node.state = lattice;
+                node.init_mcs = init_mcs;
+                node.published_T_sample = config.T_sample;
+            }
+            releaseFollowers(node, released);
+            if (node.next) {
+                releaseNode(m_nodes.at(*node.next), released);
+            }
+        }
+        std::for_each(released.begin(), released.end(), m_submit);
+    }
+
+    // config завершилась любым образом. Всё, что ждало от неё решётку и не дождалось,
+    // запускается без неё; решётка освобождается, когда её больше никто не возьмёт
+    void finish(const base_config::config_t& config)
+    {
+        std::vector<base_config::config_t> released{};
+        {
+            std::lock_guard lg{m_mutex};
+            auto& node = m_nodes.at(nodeKey(config));
+            node.finished++;
+            if (isLeader(node, config)) {
+                releaseFollowers(node, released);
+            }
+            if (node.finished == node.configs.size()) {
+                if (!node.is_published) {
+                    node.is_published = true;
+                    if (node.next) {
+                        releaseNode(m_nodes.at(*node.next), released);
+                    }
+                }
+                freeState(node);
+                if (node.prev) {
+                    freeState(m_nodes.at(*node.prev));
+                }
+            }
+        }
+        std::for_each(released.begin(), released.end(), m_submit);
+    }
+
+private:
+    using chain_key_t = std::tuple<unsigned, double, unsigned>;
+    using node_key_t = std::tuple<unsigned, double, unsigned, double, double, double>;
+
+    struct node_t {
+        base_config::magn_t field;
+        std::vector<base_config::config_t> configs{};
+        std::size_t leader = 0;
+        std::optional<node_key_t> prev{};
+        std::optional<node_key_t> next{};
+        std::size_t finished = 0;
+        bool is_released = false;
+        bool are_followers_released = false;
+        bool is_published = false;
+        std::any state{};
+        std::uint64_t init_mcs = 0;
+        double published_T_sample = 0.0;
+    };
+
+    const bool m_is_forked;
+    const bool m_is_continued;
+    std::map<node_key_t, node_t> m_nodes{};
+    submit_f m_submit{};
+    mutable std::mutex m_mutex{};
+
+    static chain_key_t chainKey(const base_config::config_t& config)
+    {
+        return {config.N, config.T_creation, config.stat_id};
+    }
+    static node_key_t nodeKey(const base_config::config_t& config)
+    {
+        return {
+            config.N,
+            config.T_creation,
+            config.stat_id,
+            config.field.x,
+            config.field.y,
+            config.field.z};
+    }
+    static bool isLeader(const node_t& node, const base_config::config_t& config)
+    {
+        return node.configs[node.leader].T_sample == config.T_sample;
+    }
+
+    // функции ниже вызываются под m_mutex
+    void releaseNode(node_t& node, std::vector<base_config::config_t>& released)
+    {
+        if (node.is_released) {
+            return;
+        }
+        node.is_released = true;
+        if (!m_is_forked) {
+            node.are_followers_released = true;
+            for (const auto& config : node.configs) {
+                released.push_back(config);
+            }
+            return;
+        }
+        released.push_back(node.configs[node.leader]);
+    }
+
+    void releaseFollowers(node_t& node, std::vector<base_config::config_t>& released)
+    {
+        if (node.are_followers_released) {
+            return;
+        }
+        node.are_followers_released = true;
+        for (auto idx = 0u; idx < node.configs.size(); ++idx) {
+            if (idx != node.leader) {
+                released.push_back(node.configs[idx]);
+            }
+        }
+    }
+
+    // решётку узла берут его ведомые и следующий узел цепочки
+    void freeState(node_t& node)
+    {
+        const bool is_next_done = !node.next
+            || m_nodes.at(*node.next).finished == m_nodes.at(*node.next).configs.size();
+        if (node.finished == node.configs.size() && is_next_done) {
+            node.state.reset();
+        }
+    }
+};
+} // namespace task
+
+#endif
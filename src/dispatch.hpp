@@ -0,0 +1,75 @@
+#ifndef DISPATCH_HPP_INCLUDED
+#define DISPATCH_HPP_INCLUDED
+
+#include "config.hpp"
+#include "plan.hpp"
+#include "system.hpp"
+#include "thread_function.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace task {
+using calculation_f = typename task::base_config::config_t (*)(
+    typename task::base_config::config_t,
+    std::string_view,
+    const cancellation_token_t&,
+    const calculation_options_t&);
+
+using calibration_f = calibration_t (*)(const base_config::config_t&, std::uint64_t);
+
+// конкретизация расчёта, её калибровка для --plan и её счётчики
+struct instantiation_t {
+    std::uint16_t L;
+    std::uint8_t N;
+    calculation_f calculation;
+    calibration_f calibrate;
+    const evolve_stats_t* stats;
+};
+
+namespace detail {
+template<std::size_t L_idx, std::size_t... N_idx>
+constexpr std::array<instantiation_t, sizeof...(N_idx)> makeInstantiationRow(
+    std::index_sequence<N_idx...>) noexcept
+{
+    constexpr auto L = base_config::L_menu[L_idx];
+    return {instantiation_t{
+        L,
+        static_cast<std::uint8_t>(N_idx + 1),
+        &calculation<L, static_cast<std::uint8_t>(N_idx + 1)>,
+        &calibrate<L, static_cast<std::uint8_t>(N_idx + 1)>,
+        &sample_t<L, static_cast<std::uint8_t>(N_idx + 1)>::stats}...};
+}
+
+template<std::size_t... L_idx>
+constexpr auto makeInstantiationTable(std::index_sequence<L_idx...>) noexcept
+{
+    return std::array{
+        makeInstantiationRow<L_idx>(std::make_index_sequence<base_config::deltas.size()>{})...};
+}
+} // namespace detail
+
+// все сочетания L из base_config::L_menu и N от 1 до deltas.size()
+inline const auto calculation_table
+    = detail::makeInstantiationTable(std::make_index_sequence<base_config::L_menu.size()>{});
+
+inline const instantiation_t& selectInstantiation(std::uint16_t L, std::uint8_t N)
+{
+    const auto L_iter = std::find(base_config::L_menu.begin(), base_config::L_menu.end(), L);
+    if (L_iter == base_config::L_menu.end() || N == 0 || N > base_config::deltas.size()) {
+        throw std::invalid_argument{
+            "There is no calculation for L = " + std::to_string(L)
+            + ", N = " + std::to_string(N)};
+    }
+    return calculation_table[static_cast<std::size_t>(L_iter - base_config::L_menu.begin())]
+                            [N - 1u];
+}
+} // namespace task
+
+#endif
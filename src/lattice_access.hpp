@@ -0,0 +1,51 @@
+#ifndef LATTICE_ACCESS_HPP_INCLUDED
+#define LATTICE_ACCESS_HPP_INCLUDED
+
+#include "config.hpp"
+
+namespace task {
+// Работа с решёткой спинов в обход multilayer_system::evolve. Используется только то, на что
+// опирается и остальной код (чтение и запись контрольных точек): T, magns и перебор плёнок
+// nanostructure и узлов плёнки через range-for. Соседей узла qss наружу не отдаёт, поэтому
+// сумму по соседям здесь посчитать нельзя
+
+// Переносит состояние решётки from в to поэлементно. Хранилище спинов to остаётся на месте:
+// на него ссылаются прокси-решётки транспорта образца (prepare_proxy_structure), поэтому
+// решётку образца нельзя заменять присваиванием или обменом с другой
+template<typename Lattice>
+void copyLatticeState(const Lattice& from, Lattice& to)
+{
+    to.T = from.T;
+    for (auto idx = 0u; idx < to.nanostructure.size(); ++idx) {
+        to.magns[idx] = from.magns[idx];
+    }
+    auto from_film = from.nanostructure.begin();
+    for (auto& film : to.nanostructure) {
+        auto from_spin = from_film->begin();
+        for (auto& spin : film) {
+            spin = *from_spin;
+            ++from_spin;
+        }
+        ++from_film;
+    }
+}
+
+// Энергия образца во внешнем поле гамильтониана createHamilton_f без обмена. Гамильтониан даёт
+// изменение энергии узла hamilt(sum, old, new) = (sum + h) * (old - new), поэтому энергия
+// узла в поле - -hamilt(0, s, 0)
+template<typename System, typename Hamiltonian>
+double getFieldEnergy(const System& system, const Hamiltonian& hamilt)
+{
+    const base_config::magn_t zero_sum{};
+    const base_config::spin_t zero_spin{0.0, 0.0, 0.0};
+    double energy = 0.0;
+    for (const auto& film : system.nanostructure) {
+        for (const auto& spin : film) {
+            energy -= hamilt(zero_sum, spin, zero_spin);
+        }
+    }
+    return energy;
+}
+} // namespace task
+
+#endif
@@ -1,17 +1,161 @@
+#include "affinity.hpp"
 #include "config.hpp"
+#include "config_dag.hpp"
 #include "cxxopts.hpp"
+#include "dispatch.hpp"
+#include "plan.hpp"
+#include "progress.hpp"
+#include "stat_pipeline.hpp"
+#include "state_cache.hpp"
+#include "sweep.hpp"
 #include "thread_function.hpp"
 #include "thread_pool.hpp"
+#include "work_queue.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
 #include <ctime>
 #include <filesystem>
 #include <future>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+// отменяется по SIGINT/SIGTERM и по истечении --deadline
+const auto sweep_token = cancellation_token_t::create();
+
+extern "C" void on_stop_signal(int)
+{
+    sweep_token.cancel();
+}
+
+// доля расчёта "i/n", 0 <= i < n
+std::pair<std::size_t, std::size_t> parse_shard(const std::string& text)
+{
+    const auto slash = text.find('/');
+    if (slash == std::string::npos) {
+        throw std::invalid_argument{"Shard must look like i/n : " + text};
+    }
+    const auto idx = std::stoul(text.substr(0, slash));
+    const auto amount = std::stoul(text.substr(slash + 1));
+    if (amount == 0 || idx >= amount) {
+        throw std::invalid_argument{"Shard index must be in [0, n) : " + text};
+    }
+    return {idx, amount};
+}
+
+// имя файла аренды в общей очереди
+std::string queue_key(const task::base_config::config_t& config)
+{
+    auto key = task::createName(config) + "/id=" + std::to_string(config.stat_id);
+    key.erase(std::remove(key.begin(), key.end(), ' '), key.end());
+    std::replace(key.begin(), key.end(), '/', '_');
+    return key;
+}
+
+// claimed_elsewhere - конфигурацию из общей очереди считает другой процесс
+enum class status_t { done, cancelled, claimed_elsewhere };
+
+// времена в секундах от начала расчёта
+struct schedule_entry_t {
+    task::base_config::config_t config;
+    double cost;
+    double start;
+    double end;
+    status_t status;
+};
+
+void report_schedule(
+    const std::vector<schedule_entry_t>& schedule,
+    const std::filesystem::path& schedule_path,
+    uint threads_amount)
+{
+    if (schedule.empty()) {
+        return;
+    }
+    std::vector<const schedule_entry_t*> sorted{};
+    sorted.reserve(schedule.size());
+    for (const auto& entry : schedule) {
+        sorted.push_back(&entry);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->start < rhs->start;
+    });
+    double makespan = 0.0;
+    double total = 0.0;
+    double longest = 0.0;
+    std::ofstream out{schedule_path};
+    out << "config\tcost\tstart, s\tend, s\tstatus\n";
+    for (const auto* entry_ptr : sorted) {
+        const auto& entry = *entry_ptr;
+        out << entry.config << "\t" << entry.cost << "\t" << entry.start << "\t" << entry.end
+            << "\t" << (entry.status == status_t::cancelled ? "cancelled" : "done") << "\n";
+        makespan = std::max(makespan, entry.end);
+        total += entry.end - entry.start;
+        longest = std::max(longest, entry.end - entry.start);
+    }
+    // раньше, чем за lower_bound, расчёт закончиться не может ни при каком порядке задач
+    const auto lower_bound = std::max(total / threads_amount, longest);
+    out << "makespan, s : " << makespan << "\n";
+    out << "lower bound, s : " << lower_bound << "\n";
+    std::cout << "sweep makespan : " << makespan << " s, lower bound : " << lower_bound
+              << " s, efficiency : " << lower_bound / makespan << "\n";
+}
+
+// скорость шагов Монте-Карло по конкретизациям sample_t<L, N>, которые запускались, средняя
+// длина подготовки с нуля и тёплым стартом в шагах (её можно сравнить с запуском без --tempering
+// или без --continuation), доля принятых обменов реплик, среднее время автокорреляции |m1| и время
+// на независимое значение |m1| - по нему, а не по MCS/s, видно, как быстро набирается статистика
+void report_instantiations(const std::filesystem::path& path)
+{
+    std::ofstream out{path};
+    out << "L\tN\tconfigs\tMCS\tMCS/s\tprepare MCS cold\tprepare MCS warm\tswap acceptance\t"
+           "tau |m1|, MCS\ts per independent |m1|\n";
+    for (const auto& row : task::calculation_table) {
+        for (const auto& instantiation : row) {
+            const auto& stats = *instantiation.stats;
+            if (stats.configs == 0) {
+                continue;
+            }
+            out << instantiation.L << "\t" << std::to_string(instantiation.N) << "\t"
+                << stats.configs << "\t" << stats.mcs << "\t" << stats.get_mcs_per_second()
+                << "\t" << stats.get_prepare_mcs_cold() << "\t" << stats.get_prepare_mcs_warm()
+                << "\t" << stats.get_swap_acceptance() << "\t"
+                << stats.get_autocorrelation_time() << "\t" << stats.get_independent_seconds()
+                << "\n";
+            std::cout << "L = " << instantiation.L << ", N = " << std::to_string(instantiation.N)
+                      << " : " << stats.configs << " configs, " << stats.get_mcs_per_second()
+                      << " MCS/s";
+            if (stats.prepared_cold > 0) {
+                std::cout << ", " << stats.get_prepare_mcs_cold() << " MCS of cold preparation";
+            }
+            if (stats.prepared_warm > 0) {
+                std::cout << ", " << stats.get_prepare_mcs_warm() << " MCS of warm preparation";
+            }
+            if (stats.swap_attempts > 0) {
+                std::cout << ", swap acceptance " << stats.get_swap_acceptance();
+            }
+            if (stats.autocorrelation_configs > 0) {
+                std::cout << ", tau |m1| " << stats.get_autocorrelation_time() << " MCS, "
+                          << stats.get_independent_seconds() << " s per independent |m1|";
+            }
+            std::cout << "\n";
+        }
+    }
+}
+} // namespace
 
 int main(int argc, char* argv[])
 {
@@ -21,7 +165,28 @@ int main(int argc, char* argv[])
     // clang-format off
     options.add_options()
         ("h,help", "Print help")
-        ("t,threads", "Initial amount of parallel threads", cxxopts::value<uint>()->default_value("2"));
+        ("t,threads", "Initial amount of parallel threads", cxxopts::value<uint>()->default_value("2"))
+        ("order", "Submission order of configs: cost (most expensive first) or config", cxxopts::value<std::string>()->default_value("cost"))
+        ("pin", "Pin worker threads to cpus: none, compact or scatter", cxxopts::value<std::string>()->default_value("none"))
+        ("deadline", "Wall-clock budget of the whole sweep in hours, 0 - unlimited", cxxopts::value<double>()->default_value("0"))
+        ("task-limit", "Wall-clock budget of one config in hours, 0 - unlimited", cxxopts::value<double>()->default_value("0"))
+        ("mem-budget", "Memory budget for concurrently running configs in GiB, 0 - unlimited", cxxopts::value<double>()->default_value("0"))
+        ("progress-interval", "Seconds between progress tables of running configs, also written to status.txt of the data folder, 0 - off", cxxopts::value<uint>()->default_value("60"))
+        ("checkpoint-interval", "Observation MCS between checkpoints of one config, 0 - no checkpoints", cxxopts::value<std::uint64_t>()->default_value("500"))
+        ("shard", "Calculate only the i-th of n cost-balanced parts of the sweep, i/n with 0 <= i < n", cxxopts::value<std::string>())
+        ("sweep", "Sweep file with the lists of N, T, h and MCS counts, see sweep.hpp", cxxopts::value<std::string>())
+        ("plan", "Only estimate time, memory and output volume of the sweep by a short calibration")
+        ("plan-mcs", "MCS of each calibration run of --plan", cxxopts::value<std::uint64_t>()->default_value("20"))
+        ("fork", "Prepare each (N, T_creation, h, stat_id) once and copy the prepared sample into its configs with other T_sample")
+        ("continuation", "Prepare each config from the prepared lattice of the previous |h| with the same N, T_creation and stat_id")
+        ("tempering", "Replicas of the replica-exchange preparation, 0 or 1 - plain Metropolis preparation", cxxopts::value<uint>()->default_value("0"))
+        ("tempering-step", "Field step of the replica ladder (h + k * step along x), 0 - 0.05", cxxopts::value<double>()->default_value("0"))
+        ("tempering-interval", "MCS between swap attempts of neighbouring replicas", cxxopts::value<std::uint64_t>()->default_value("10"))
+        ("state-cache", "Folder of prepared samples shared between sweeps: preparation is loaded from it when possible and stored to it otherwise", cxxopts::value<std::string>())
+        ("stat-pipeline", "Process statistics of each group of replicas as soon as it is calculated, in parallel with the rest of the sweep", cxxopts::value<bool>()->default_value("true"))
+        ("queue", "Take configs from a work queue in the given data folder shared with other processes", cxxopts::value<std::string>())
+        ("lease-timeout", "Seconds without renewal after which a lease in the work queue is reclaimed", cxxopts::value<uint>()->default_value("120"))
+        ("resume", "Continue the sweep in the given data_* folder: calculated configs are skipped, interrupted ones restart from checkpoints", cxxopts::value<std::string>());
     // clang-format on
 
     auto initOpts = options.parse(argc, argv);
@@ -35,12 +200,112 @@ int main(int argc, char* argv[])
     auto tm = *std::localtime(&t);
     std::ostringstream oss;
     oss << std::put_time(&tm, "%Y-%m-%d_%H-%M-%S");
-    const auto time = "data_" + oss.str();
+    const auto shard = initOpts.count("shard")
+        ? parse_shard(initOpts["shard"].as<std::string>())
+        : std::pair<std::size_t, std::size_t>{0, 1};
+    const bool is_sharded = shard.second > 1;
+    const auto time = "data_" + oss.str()
+        + (is_sharded
+               ? "_shard_" + std::to_string(shard.first) + "_of_" + std::to_string(shard.second)
+               : "");
 
     const auto threads_amount = initOpts["threads"].as<uint>();
     std::cout << "threads_amount: " << threads_amount << "\n";
+    const auto order = initOpts["order"].as<std::string>();
+    if (order != "cost" && order != "config") {
+        std::cout << "unknown order : " << order << "\n";
+        exit(1);
+    }
+    const auto pin_policy = affinity::parse_policy(initOpts["pin"].as<std::string>());
+    using hours = std::chrono::duration<double, std::ratio<3600>>;
+    const auto deadline = hours{initOpts["deadline"].as<double>()};
+    const auto task_limit = hours{initOpts["task-limit"].as<double>()};
+    const auto mem_budget = static_cast<std::size_t>(
+        initOpts["mem-budget"].as<double>() * 1024.0 * 1024.0 * 1024.0);
+
+    const bool is_queued = initOpts.count("queue") > 0;
+    const bool is_forked = initOpts.count("fork") > 0;
+    const bool is_continued = initOpts.count("continuation") > 0;
+    if (is_queued && (is_sharded || initOpts.count("resume") || is_forked || is_continued)) {
+        std::cout
+            << "--queue can not be combined with --shard, --resume, --fork or --continuation\n";
+        exit(1);
+    }
+    // конфигурация из очереди могла быть прервана другим процессом, поэтому её
+    // контрольная точка всегда подхватывается
+    const task::checkpoint_options_t checkpoint_options{
+        initOpts["checkpoint-interval"].as<std::uint64_t>(),
+        initOpts.count("resume") > 0 || is_queued};
+    task::tempering_options_t tempering_options{};
+    tempering_options.replicas = initOpts["tempering"].as<uint>();
+    tempering_options.step = initOpts["tempering-step"].as<double>();
+    tempering_options.interval = initOpts["tempering-interval"].as<std::uint64_t>();
 
-    const auto init_dir = std::filesystem::current_path() / task::results_folder / time;
+    const auto init_dir = is_queued
+        ? std::filesystem::absolute(initOpts["queue"].as<std::string>())
+        : initOpts.count("resume") ? std::filesystem::absolute(initOpts["resume"].as<std::string>())
+                                   : std::filesystem::current_path() / task::results_folder / time;
+    if (initOpts.count("resume")) {
+        if (!std::filesystem::exists(init_dir / task::raw_data_folder)) {
+            std::cout << "nothing to resume in " << init_dir.string() << "\n";
+            exit(1);
+        }
+        std::cout << "resuming " << init_dir.string() << "\n";
+    }
+    // развёртка продолжаемого расчёта берётся из его папки, если не задана явно
+    const auto sweep_path = init_dir / "sweep.toml";
+    try {
+        if (initOpts.count("sweep")) {
+            task::loadSweep(initOpts["sweep"].as<std::string>());
+        } else if (std::filesystem::exists(sweep_path)) {
+            task::loadSweep(sweep_path);
+        }
+    } catch (const task::sweep_exception& exc) {
+        std::cout << exc.what() << "\n";
+        exit(1);
+    }
+
+    // калибровка по одной конфигурации на каждое N, расчёт не запускается
+    if (initOpts.count("plan")) {
+        if (initOpts["plan-mcs"].as<std::uint64_t>() == 0) {
+            std::cout << "--plan-mcs must be positive\n";
+            exit(1);
+        }
+        auto plan_configs = task::base_config::getConfigs();
+        if (is_sharded) {
+            plan_configs = task::selectShard(plan_configs, shard.first, shard.second);
+        }
+        std::map<unsigned, task::calibration_t> calibrations{};
+        for (const auto& config : plan_configs) {
+            if (calibrations.count(config.N) == 0) {
+                std::cout << "calibration of N = " << std::to_string(config.N) << "\n";
+                calibrations[config.N]
+                    = task::selectInstantiation(task::base_config::L, config.N)
+                          .calibrate(config, initOpts["plan-mcs"].as<std::uint64_t>());
+            }
+        }
+        const task::sweep_plan_t plan{plan_configs, calibrations, threads_amount};
+        task::printPlan(std::cout, calibrations, plan, threads_amount);
+        const auto results_dir = std::filesystem::current_path() / task::results_folder;
+        std::filesystem::create_directories(results_dir);
+        std::ofstream plan_out{results_dir / "plan.txt"};
+        task::printPlan(plan_out, calibrations, plan, threads_amount);
+        return 0;
+    }
+
+    // путь к кэшу задаётся относительно папки запуска, до перехода в папку данных
+    std::optional<task::state_cache_t> state_cache{};
+    if (initOpts.count("state-cache")) {
+        state_cache.emplace(std::filesystem::absolute(initOpts["state-cache"].as<std::string>()));
+    }
+
+    std::filesystem::create_directories(init_dir);
+    try {
+        task::storeSweep(sweep_path);
+    } catch (const task::sweep_exception& exc) {
+        std::cout << exc.what() << "\n";
+        exit(1);
+    }
     {
         std::ofstream info{std::filesystem::current_path() / task::results_folder / "info.txt"};
         info << init_dir.string() << "\t" << task::raw_data_folder << "\n";
@@ -54,40 +319,329 @@ int main(int argc, char* argv[])
     std::filesystem::current_path(currentDir);
 
     auto configs = task::base_config::getConfigs();
+    if (is_sharded) {
+        configs = task::selectShard(configs, shard.first, shard.second);
+        std::cout << "shard " << shard.first << " of " << shard.second << " : " << configs.size()
+                  << " configs\n";
+    }
     std::for_each(configs.begin(), configs.end(), [](const auto& config) {
         std::filesystem::create_directories(
             std::filesystem::current_path() / task::createName(config));
     });
 
+    // при продолжении пересчитываются только недописанные конфигурации
+    std::vector<task::base_config::config_t> calculated{};
+    if (initOpts.count("resume")) {
+        const auto configs_amount = configs.size();
+        // config_t нельзя присваивать, поэтому недописанные собираются в новый вектор
+        std::vector<task::base_config::config_t> missing{};
+        for (const auto& config : configs) {
+            if (!task::isCalculated(config, currentDir)) {
+                missing.push_back(config);
+            } else {
+                calculated.push_back(config);
+            }
+        }
+        configs = std::move(missing);
+        std::cout << configs_amount - configs.size() << " of " << configs_amount
+                  << " configs already calculated, " << configs.size() << " submitted\n";
+    }
+
+    // граф строится по оставшимся конфигурациям: у уже посчитанных нет подготовленной
+    // решётки, и зависевшие от них конфигурации становятся начальными
+    std::optional<task::config_dag_t> config_dag{};
+    if (is_forked || is_continued) {
+        config_dag.emplace(configs, is_forked, is_continued);
+    }
+
+    std::optional<work_queue_t> work_queue{};
+    if (is_queued) {
+        work_queue.emplace(
+            init_dir / "queue", std::chrono::seconds{initOpts["lease-timeout"].as<uint>()});
+        std::cout << "work queue " << (init_dir / "queue").string() << ", owner "
+                  << work_queue->get_owner() << "\n";
+    }
+    // в режиме очереди отчёты каждого процесса пишутся в свои файлы
+    const auto report_suffix = work_queue ? "_" + work_queue->get_owner() : std::string{};
+
+    // таблица выполняемых конфигураций обновляется в своём потоке и переживает пул. Пока идёт
+    // развёртка, в std::cout пишут несколько потоков, каждая их запись идёт под output_mutex
+    std::mutex output_mutex{};
+    task::progress_board_t progress_board{};
+    if (const auto interval = initOpts["progress-interval"].as<uint>(); interval > 0) {
+        progress_board.startReporting(
+            std::chrono::seconds{interval},
+            init_dir / ("status" + report_suffix + ".txt"),
+            std::cout,
+            output_mutex);
+    }
+
     thread_pool_t thread_pool{threads_amount};
+    {
+        const auto cpus = affinity::read_topology();
+        const auto pinning_order = affinity::make_pinning_order(cpus, pin_policy);
+        if (!pinning_order.empty()) {
+            thread_pool.set_worker_init([cpus, pinning_order, &output_mutex](std::size_t idx) {
+                const auto cpu = pinning_order[idx % pinning_order.size()];
+                std::ostringstream message{};
+                message << "thread " << idx;
+                if (affinity::pin_current_thread(cpu)) {
+                    message << " pinned to cpu " << cpu << " (node " << affinity::node_of(cpus, cpu)
+                            << ")\n";
+                } else {
+                    message << " failed to pin to cpu " << cpu << "\n";
+                }
+                std::lock_guard lg{output_mutex};
+                std::cout << message.str();
+            });
+        }
+    }
+    std::ofstream admission_out{};
+    if (mem_budget > 0) {
+        admission_out.open(init_dir / "admission.txt");
+        thread_pool.set_memory_budget(
+            mem_budget, [&admission_out, &output_mutex](const std::string& message) {
+                std::lock_guard lg{output_mutex};
+                std::cout << message << "\n";
+                admission_out << message << std::endl;
+            });
+    }
+
+    // доля и процесс очереди видят не все реплики групп, их статистика считается в конце
+    std::optional<stat::stat_pipeline_t> stat_pipeline{};
+    if (initOpts["stat-pipeline"].as<bool>() && !is_sharded && !is_queued) {
+        stat_pipeline.emplace(thread_pool, init_dir, task::raw_data_folder);
+        for (const auto& config : calculated) {
+            stat_pipeline->completed(config);
+        }
+    }
+
+    const auto sweep_start = std::chrono::steady_clock::now();
+    const auto task_token = deadline.count() > 0
+        ? cancellation_token_t::create(
+            sweep_token,
+            sweep_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline))
+        : sweep_token;
+    std::signal(SIGINT, on_stop_signal);
+    std::signal(SIGTERM, on_stop_signal);
+
+    auto timed_calculation = [sweep_start,
+                              task_token,
+                              task_limit,
+                              checkpoint_options,
+                              tempering_options,
+                              &work_queue,
+                              &progress_board,
+                              &output_mutex,
+                              &state_cache,
+                              &config_dag](
+                                 task::base_config::config_t config,
+                                 std::string_view dir,
+                                 double cost) {
+        using seconds = std::chrono::duration<double>;
+        const auto start = std::chrono::steady_clock::now();
+        // отдельный токен задачи: его отменяет и потеря аренды в очереди
+        const auto token = cancellation_token_t::create(
+            task_token,
+            task_limit.count() > 0
+                ? std::optional{
+                    start
+                    + std::chrono::duration_cast<std::chrono::steady_clock::duration>(task_limit)}
+                : std::nullopt);
+        const auto key = queue_key(config);
+        if (work_queue && work_queue->try_claim(key, token) != work_queue_t::claim_t::claimed) {
+            return schedule_entry_t{
+                std::move(config),
+                cost,
+                seconds(start - sweep_start).count(),
+                seconds(start - sweep_start).count(),
+                status_t::claimed_elsewhere};
+        }
+        std::ostringstream label{};
+        label << config;
+        const auto progress = progress_board.add(label.str());
+        auto status = status_t::done;
+        try {
+            if (token.is_cancelled()) {
+                throw task_cancelled{"start"};
+            }
+            const auto& instantiation = task::selectInstantiation(task::base_config::L, config.N);
+            task::calculation_options_t calculation_options{};
+            calculation_options.checkpoint = checkpoint_options;
+            calculation_options.tempering = tempering_options;
+            calculation_options.progress = progress.get();
+            calculation_options.state_cache = state_cache ? &*state_cache : nullptr;
+            calculation_options.config_dag = config_dag ? &*config_dag : nullptr;
+            instantiation.calculation(config, dir, token, calculation_options);
+            if (work_queue) {
+                work_queue->complete(key);
+            }
+        } catch (const task_cancelled& exc) {
+            std::unique_lock ul{output_mutex};
+            // потерянная аренда не отменяет развёртку: конфигурацию досчитает новый владелец
+            if (work_queue && !task_token.is_cancelled() && work_queue->is_lost(key)) {
+                std::cout << "config : " << config << "\t --- lease taken over at " << exc.what()
+                          << "\n";
+                status = status_t::claimed_elsewhere;
+            } else {
+                std::cout << "config : " << config << "\t --- cancelled at " << exc.what()
+                          << "\n";
+                status = status_t::cancelled;
+            }
+            ul.unlock();
+            if (work_queue) {
+                work_queue->release(key);
+            }
+        } catch (...) {
+            if (config_dag) {
+                config_dag->finish(config);
+            }
+            throw;
+        }
+        if (config_dag) {
+            config_dag->finish(config);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return schedule_entry_t{
+            std::move(config),
+            cost,
+            seconds(start - sweep_start).count(),
+            seconds(end - sweep_start).count(),
+            status};
+    };
+
+    completion_queue_t<schedule_entry_t> completed{};
+    // с графом конфигураций отменённая задача всё равно запускается, чтобы граф узнал
+    // о её завершении и поставил зависевшие от неё конфигурации
+    auto submit = [&completed,
+                   &thread_pool,
+                   &currentDir,
+                   &timed_calculation,
+                   &order,
+                   pool_token = config_dag ? cancellation_token_t{} : task_token](
+                      auto config) -> void {
+        std::string_view dir = currentDir;
+        const auto cost = task::estimateCost(config);
+        std::ostringstream label{};
+        label << config;
+        const thread_pool_t::task_info_t info{
+            order == "cost" ? cost : 0.0, pool_token, task::estimateMemory(config), label.str()};
+        thread_pool.add_task(
+            completed, info, timed_calculation, std::move(config), std::move(dir), cost);
+    };
+
+    // каждая конфигурация отмечается в completed.txt сразу после завершения.
+    // В режиме очереди конфигурации, занятые другими процессами, перепроверяются по кругу,
+    // пока они не будут посчитаны или их аренда не станет брошенной
+    std::ofstream completed_out{init_dir / ("completed" + report_suffix + ".txt")};
+    std::vector<schedule_entry_t> schedule{};
+    schedule.reserve(configs.size());
+    std::size_t cancelled_amount = 0;
+    // при продолжении посчитанной развёртки потоки нужны только конвейеру статистики
+    if (configs.empty()) {
+        thread_pool.init();
+    }
+    for (auto round = 0u; !configs.empty(); ++round) {
+        if (config_dag) {
+            config_dag->set_submit(submit);
+            const auto heads = config_dag->getHeads();
+            std::for_each(heads.begin(), heads.end(), submit);
+        } else {
+            std::for_each(configs.begin(), configs.end(), submit);
+        }
+        if (round == 0) {
+            thread_pool.init();
+        }
 
-    std::vector<std::future<task::base_config::config_t>> futures{};
-    futures.reserve(configs.size());
-    std::for_each(
-        configs.begin(), configs.end(), [&futures, &thread_pool, &currentDir](auto config) -> void {
-            std::string_view dir = currentDir;
-            futures.push_back(
-                thread_pool.add_task(task::calculation, std::move(config), std::move(dir)));
-        });
-
-    thread_pool.init();
-
-    while (!futures.empty()) {
-        for (auto iter = futures.begin(); iter != futures.end(); ++iter) {
-            auto& future = *iter;
-            const auto status = future.wait_for(std::chrono::seconds(3));
-            if (status != std::future_status::timeout) {
-                const auto result = future.get();
-                std::cout << "config : " << result << "\t --- done \n";
-                futures.erase(iter);
-                break;
+        std::vector<task::base_config::config_t> claimed_elsewhere{};
+        for (auto left = configs.size(); left > 0; --left) {
+            try {
+                auto result = completed.pop().get();
+                if (result.status == status_t::claimed_elsewhere) {
+                    if (!work_queue->is_done(queue_key(result.config))) {
+                        claimed_elsewhere.push_back(result.config);
+                    }
+                    continue;
+                }
+                if (result.status == status_t::cancelled) {
+                    cancelled_amount++;
+                } else {
+                    std::lock_guard lg{output_mutex};
+                    std::cout << "config : " << result.config << "\t --- done in "
+                              << result.end - result.start << " s, " << left - 1 << " left\n";
+                    completed_out << result.config << "\t" << result.end - result.start
+                                  << std::endl;
+                    if (stat_pipeline) {
+                        stat_pipeline->completed(result.config);
+                    }
+                }
+                schedule.push_back(std::move(result));
+            } catch (const task_cancelled&) {
+                cancelled_amount++;
             }
         }
+        if (cancelled_amount > 0 || task_token.is_cancelled()) {
+            break;
+        }
+        if (claimed_elsewhere.size() == configs.size()) {
+            std::this_thread::sleep_for(
+                std::chrono::seconds{std::max(1u, initOpts["lease-timeout"].as<uint>() / 4)});
+        }
+        configs = std::move(claimed_elsewhere);
     }
+    completed_out.close();
+    // дальше в std::cout пишет только этот поток
+    progress_board.stopReporting();
 
-    stat::stater::makeStat(init_dir, task::raw_data_folder);
-    stat::stater::calcGMR(init_dir);
-    stat::stater::calcP(init_dir);
+    report_schedule(schedule, init_dir / ("schedule" + report_suffix + ".txt"), threads_amount);
+    for (const auto& stats : thread_pool.get_workers_stats()) {
+        using seconds = std::chrono::duration<double>;
+        std::cout << "thread " << stats.id << " : busy "
+                  << std::chrono::duration_cast<seconds>(stats.busy).count() << " s, idle "
+                  << std::chrono::duration_cast<seconds>(stats.idle).count() << " s, tasks "
+                  << stats.tasks_done << "\n";
+    }
+
+    report_instantiations(init_dir / ("instantiations" + report_suffix + ".txt"));
+    if (state_cache) {
+        state_cache->report(std::cout);
+        std::ofstream cache_out{init_dir / ("state_cache" + report_suffix + ".txt")};
+        state_cache->report(cache_out);
+    }
+
+    if (stat_pipeline) {
+        stat_pipeline->wait();
+        std::cout << stat_pipeline->get_processed_amount()
+                  << " groups of replicas processed by the stat pipeline\n";
+    }
+
+    if (cancelled_amount > 0) {
+        std::cout << cancelled_amount << " configs cancelled, stat calculations"
+                  << (stat_pipeline ? " of their groups" : "") << " skipped\n";
+        return 1;
+    }
+
+    // статистика по доле неполна, её считает stat --merge по всем долям
+    if (is_sharded) {
+        std::cout << "shard done, merge with : stat --merge <data folders of all shards>\n";
+        return 0;
+    }
+
+    // статистику по общей очереди считает один процесс, захвативший её первым
+    if (work_queue
+        && work_queue->try_claim("stat", cancellation_token_t{}) != work_queue_t::claim_t::claimed) {
+        std::cout << "sweep done, stat calculations are left to another process\n";
+        return 0;
+    }
+
+    if (!stat_pipeline) {
+        stat::stater::makeStat(init_dir, task::raw_data_folder);
+        stat::stater::calcGMR(init_dir);
+        stat::stater::calcP(init_dir);
+    }
+    if (work_queue) {
+        work_queue->complete("stat");
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -1,12 +1,119 @@
+#include "config.hpp"
+#include "cxxopts.hpp"
+#include "output.hpp"
 #include "stat.hpp"
+#include "sweep.hpp"
 
+#include <ctime>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
-int main()
+namespace {
+// объединяет raw-папки долей в result_dir/raw. Доли не пересекаются, поэтому совпадение файлов
+// означает, что конфигурация посчитана дважды: остаётся копия из первой доли
+void merge_shards(
+    const std::vector<std::string>& shard_dirs, const std::filesystem::path& result_dir)
 {
+    namespace fs = std::filesystem;
+    const auto merged_raw = result_dir / task::raw_data_folder;
+    fs::create_directories(merged_raw);
+    std::size_t copied = 0;
+    std::size_t duplicates = 0;
+    for (const auto& shard_dir : shard_dirs) {
+        const auto raw = fs::absolute(shard_dir) / task::raw_data_folder;
+        if (!fs::exists(raw)) {
+            throw std::runtime_error{"There is no " + raw.string()};
+        }
+        for (const auto& entry : fs::recursive_directory_iterator{raw}) {
+            const auto name = entry.path().filename().string();
+            if (!entry.is_regular_file() || name.rfind("checkpoint_id=", 0) == 0) {
+                continue;
+            }
+            const auto target = merged_raw / fs::relative(entry.path(), raw);
+            if (fs::exists(target)) {
+                duplicates++;
+                continue;
+            }
+            fs::create_directories(target.parent_path());
+            fs::copy_file(entry.path(), target);
+            copied++;
+        }
+        std::cout << "\t" << shard_dir << " merged\n";
+    }
+    std::cout << copied << " files merged into " << merged_raw.string();
+    if (duplicates > 0) {
+        std::cout << ", " << duplicates << " duplicated files skipped";
+    }
+    std::cout << "\n";
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    cxxopts::Options options(
+        "stat", "Statistics of calculated data, optionally merged from sweep shards.");
+
+    // clang-format off
+    options.add_options()
+        ("h,help", "Print help")
+        ("merge", "data_* folders of sweep shards to merge before statistics", cxxopts::value<std::vector<std::string>>())
+        ("output", "Folder for merged data, default - new data_*_merged in results", cxxopts::value<std::string>());
+    // clang-format on
+    options.parse_positional({"merge"});
+    options.positional_help("[shard folders...]");
+
+    auto initOpts = options.parse(argc, argv);
+    if (initOpts.count("help")) {
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    if (initOpts.count("merge")) {
+        std::filesystem::path result_dir{};
+        if (initOpts.count("output")) {
+            result_dir = std::filesystem::absolute(initOpts["output"].as<std::string>());
+        } else {
+            auto t = std::time(nullptr);
+            auto tm = *std::localtime(&t);
+            std::ostringstream oss;
+            oss << std::put_time(&tm, "%Y-%m-%d_%H-%M-%S");
+            result_dir = std::filesystem::current_path() / task::results_folder
+                / ("data_" + oss.str() + "_merged");
+        }
+        const auto shard_dirs = initOpts["merge"].as<std::vector<std::string>>();
+        merge_shards(shard_dirs, result_dir);
+        // все доли считали одну развёртку, берётся первая
+        if (const auto sweep_path = std::filesystem::path{shard_dirs.front()} / "sweep.toml";
+            std::filesystem::exists(sweep_path)) {
+            task::loadSweep(sweep_path);
+            std::filesystem::copy_file(
+                sweep_path,
+                result_dir / "sweep.toml",
+                std::filesystem::copy_options::overwrite_existing);
+        }
+
+        std::size_t missing = 0;
+        for (const auto& config : task::base_config::getConfigs()) {
+            if (!task::isCalculated(config, result_dir / task::raw_data_folder)) {
+                std::cout << "config : " << config << "\t --- missing\n";
+                missing++;
+            }
+        }
+        if (missing > 0) {
+            std::cout << missing << " configs are missing, stat calculations skipped\n";
+            return 1;
+        }
+
+        std::ofstream info{std::filesystem::current_path() / task::results_folder / "info.txt"};
+        info << result_dir.string() << "\t" << task::raw_data_folder << "\n";
+        info << task::create_config_info();
+    }
+
     std::ifstream info{std::filesystem::current_path() / task::results_folder / "info.txt"};
     std::vector<std::string> vals;
     std::string line{};
@@ -16,6 +123,11 @@ int main()
         vals.push_back(value);
     }
 
+    if (const auto sweep_path = std::filesystem::path{vals[0]} / "sweep.toml";
+        std::filesystem::exists(sweep_path)) {
+        task::loadSweep(sweep_path);
+    }
+
     stat::stater::makeStat(std::filesystem::path{vals[0]}, vals[1]);
     stat::stater::calcGMR(std::filesystem::path{vals[0]});
     stat::stater::calcP(std::filesystem::path{vals[0]});
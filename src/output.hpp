@@ -3,10 +3,13 @@
 
 #include "config.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
+#include <iterator>
 #include <string>
 #include <string_view>
 #include <type_traits>
@@ -52,6 +55,11 @@ public:
         std::filesystem::current_path(current_dir);
     }
 
+    const std::filesystem::path& getFolder() const noexcept
+    {
+        return folder;
+    }
+
     outputer_t& EnterDirectory(std::string_view directory_name)
     {
         using std::filesystem::current_path;
@@ -101,6 +109,18 @@ public:
             return *this;
         }
 
+        output_file_t& flush() noexcept
+        {
+            out.flush();
+            return *this;
+        }
+
+        // длина файла в байтах, вызывать после flush
+        std::uint64_t position() noexcept
+        {
+            return static_cast<std::uint64_t>(out.tellp());
+        }
+
         ~output_file_t()
         {
             out.flush();
@@ -114,6 +134,56 @@ public:
         res << std::fixed;
         return res;
     }
+
+    // обрезает существующий файл до length байт и продолжает запись с его конца
+    output_file_t reopenFile(const std::string& name, std::uint64_t length) const
+    {
+        std::filesystem::resize_file(folder / name, length);
+        std::ofstream res{folder / name, std::ios::in | std::ios::out};
+        res.seekp(0, std::ios::end);
+        res << std::fixed;
+        return res;
+    }
 };
 
+namespace task {
+namespace detail {
+inline std::uint64_t countLines(const std::filesystem::path& path)
+{
+    std::ifstream in{path};
+    return static_cast<std::uint64_t>(
+        std::count(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}, '\n'));
+}
+} // namespace detail
+
+// конфигурация посчитана, если её m_id и j, Nup и Ndown всех наборов реплик дописаны до конца:
+// заголовок и по строке на каждый шаг наблюдения (для транспорта - mcs_observation шагов
+// начиная со своего t_wait)
+inline bool isCalculated(
+    const typename task::base_config::config_t& config, const std::filesystem::path& current_dir)
+{
+    using task::base_config;
+    const auto mcs_amount = base_config::mcs_observation + base_config::t_wait_vec.back();
+    const auto j_lines_amount = base_config::mcs_observation + 1;
+    const auto folder = current_dir / task::createName(config);
+
+    if (detail::countLines(folder / ("m_id=" + std::to_string(config.stat_id) + ".txt"))
+        != mcs_amount + 1) {
+        return false;
+    }
+    for (const auto t_wait : base_config::t_wait_vec) {
+        for (auto idx = 0u; idx < base_config::j_stat_amount; ++idx) {
+            const auto j_id = std::to_string(config.stat_id * base_config::j_stat_amount + idx);
+            for (const auto* name : {"j", "Nup", "Ndown"}) {
+                const auto file_name = createTransportName(name, t_wait) + "_id=" + j_id + ".txt";
+                if (detail::countLines(folder / file_name) != j_lines_amount) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+} // namespace task
+
 #endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#ifndef PLAN_HPP_INCLUDED
+#define PLAN_HPP_INCLUDED
+
+#include "config.hpp"
+#include "system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace task {
+// замеры одной конкретизации sample_t<L, N> на одном потоке
+struct calibration_t {
+    double evolve_seconds = 0.0;    // один шаг Монте-Карло
+    double transport_seconds = 0.0; // один spin_transport::perform
+    std::size_t resident_bytes = 0; // образец вместе с репликами транспорта
+};
+
+namespace detail {
+inline std::size_t residentBytes()
+{
+    std::ifstream statm{"/proc/self/statm"};
+    std::size_t size = 0;
+    std::size_t resident = 0;
+    statm >> size >> resident;
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+} // namespace detail
+
+// создаёт образец, делает mcs_amount > 0 шагов при T_sample и mcs_amount расчётов тока
+// по всем репликам. Размер образца - прирост резидентной памяти процесса, но не меньше
+// estimateMemory: калибровки идут подряд, и следующая занимает страницы, освобождённые
+// предыдущей, поэтому прирост занижен (а без /proc он равен нулю)
+template<std::uint16_t L, std::uint8_t N>
+calibration_t calibrate(const base_config::config_t& config, std::uint64_t mcs_amount)
+{
+    using clock_t = std::chrono::steady_clock;
+    using seconds = std::chrono::duration<double>;
+    calibration_t result{};
+
+    const auto resident_before = detail::residentBytes();
+    auto sample = createSample<L, N>(config);
+    const auto resident_after = detail::residentBytes();
+    result.resident_bytes = std::max(
+        resident_after > resident_before ? resident_after - resident_before : std::size_t{0},
+        estimateMemory(config));
+
+    const auto evolve_start = clock_t::now();
+    for (auto mcs = 0u; mcs < mcs_amount; ++mcs) {
+        sample.makeMonteCarloStep();
+    }
+    result.evolve_seconds
+        = seconds(clock_t::now() - evolve_start).count() / static_cast<double>(mcs_amount);
+
+    sample.startObservation();
+    const auto transport_start = clock_t::now();
+    for (auto mcs = 0u; mcs < mcs_amount; ++mcs) {
+        sample.makeJCalc();
+    }
+    result.transport_seconds = seconds(clock_t::now() - transport_start).count()
+        / static_cast<double>(mcs_amount * base_config::j_stat_amount);
+    return result;
+}
+
+// Прогноз развёртки по замерам для каждого N. Число шагов подготовки и динамической стадии
+// заранее неизвестно, берётся минимальное: mcs_init и 500 шагов окна динамической стадии.
+// Время при threads_amount потоках - расписание "самая долгая конфигурация на самый свободный
+// поток", пик памяти - сумма threads_amount самых больших образцов
+class sweep_plan_t {
+public:
+    struct config_plan_t {
+        double seconds;
+        std::size_t resident_bytes;
+        std::size_t output_bytes;
+    };
+
+    // ширина поля вывода 10 символов и табуляция, строка заканчивается переводом строки.
+    // Размеры строк на шаг: m - 8 полей, cos_theta и cos_thetaXZ - по 1,
+    // j, Nup и Ndown каждой реплики - по 2
+    constexpr static std::size_t field_bytes = 11;
+    constexpr static std::size_t m_line_bytes = 8 * field_bytes + 1;
+    constexpr static std::size_t cos_line_bytes = field_bytes + 1;
+    constexpr static std::size_t transport_line_bytes = 2 * field_bytes + 1;
+
+    static config_plan_t planConfig(const calibration_t& calibration)
+    {
+        constexpr std::uint64_t dynamic_window = 500;
+        const auto observation = base_config::mcs_observation + base_config::t_wait_vec.back();
+        const auto transport_steps
+            = base_config::mcs_observation * base_config::t_wait_vec.size();
+        const auto evolve_steps = base_config::mcs_init + dynamic_window + observation;
+
+        const auto seconds = static_cast<double>(evolve_steps) * calibration.evolve_seconds
+            + static_cast<double>(transport_steps * base_config::j_stat_amount)
+                * calibration.transport_seconds;
+
+        constexpr auto spin_line_bytes = m_line_bytes + 2 * cos_line_bytes;
+        const auto output_bytes = (observation + dynamic_window) * spin_line_bytes
+            + transport_steps * base_config::j_stat_amount * 3 * transport_line_bytes;
+        return {seconds, calibration.resident_bytes, static_cast<std::size_t>(output_bytes)};
+    }
+
+    sweep_plan_t(
+        const std::vector<base_config::config_t>& configs,
+        const std::map<unsigned, calibration_t>& calibrations,
+        unsigned threads_amount)
+    {
+        std::vector<config_plan_t> plans{};
+        for (const auto& config : configs) {
+            plans.push_back(planConfig(calibrations.at(config.N)));
+        }
+        std::sort(plans.begin(), plans.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.seconds > rhs.seconds;
+        });
+
+        std::priority_queue<double, std::vector<double>, std::greater<double>> threads{};
+        for (auto idx = 0u; idx < std::max(threads_amount, 1u); ++idx) {
+            threads.push(0.0);
+        }
+        for (const auto& plan : plans) {
+            cpu_seconds += plan.seconds;
+            output_bytes += plan.output_bytes;
+            const auto finish = threads.top() + plan.seconds;
+            threads.pop();
+            threads.push(finish);
+            wall_seconds = std::max(wall_seconds, finish);
+        }
+        std::sort(plans.begin(), plans.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.resident_bytes > rhs.resident_bytes;
+        });
+        for (auto idx = 0u; idx < std::min<std::size_t>(threads_amount, plans.size()); ++idx) {
+            peak_bytes += plans[idx].resident_bytes;
+        }
+        configs_amount = configs.size();
+    }
+
+    std::size_t configs_amount = 0;
+    double cpu_seconds = 0.0;
+    double wall_seconds = 0.0;
+    std::size_t peak_bytes = 0;
+    std::size_t output_bytes = 0;
+};
+
+inline void printPlan(
+    std::ostream& out,
+    const std::map<unsigned, calibration_t>& calibrations,
+    const sweep_plan_t& plan,
+    unsigned threads_amount)
+{
+    constexpr auto GiB = 1024.0 * 1024.0 * 1024.0;
+    out << "calibration, L = " << base_config::L << " :\n";
+    out << "N\tevolve, s/MCS\tperform, s/call\tresident, MiB\tconfig, h\n";
+    for (const auto& [N, calibration] : calibrations) {
+        out << N << "\t" << calibration.evolve_seconds << "\t" << calibration.transport_seconds
+            << "\t" << static_cast<double>(calibration.resident_bytes) / (1024.0 * 1024.0) << "\t"
+            << sweep_plan_t::planConfig(calibration).seconds / 3600.0 << "\n";
+    }
+    out << "output, bytes per MCS per file : m " << sweep_plan_t::m_line_bytes << ", cos_theta "
+        << sweep_plan_t::cos_line_bytes << ", cos_thetaXZ " << sweep_plan_t::cos_line_bytes
+        << ", j/Nup/Ndown " << sweep_plan_t::transport_line_bytes << " each ("
+        << base_config::j_stat_amount << " replicas for each of " << base_config::t_wait_vec.size()
+        << " t_wait)\n";
+    out << "configs : " << plan.configs_amount << "\n";
+    out << "cpu time, h : " << plan.cpu_seconds / 3600.0 << "\n";
+    out << "wall time at " << threads_amount << " threads, h : " << plan.wall_seconds / 3600.0
+        << "\n";
+    out << "peak memory, GiB : " << static_cast<double>(plan.peak_bytes) / GiB << "\n";
+    out << "output volume, GiB : " << static_cast<double>(plan.output_bytes) / GiB << "\n";
+}
+} // namespace task
+
+#endif
@@ -0,0 +1,145 @@
+#include "cxxopts.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+std::atomic<std::uint64_t> sink{0};
+// корневых задач в сценарии nested
+constexpr std::size_t roots_amount = 4;
+
+void do_work(std::size_t work) noexcept
+{
+    double value = 0.0;
+    for (auto idx = 0u; idx < work; ++idx) {
+        value += std::sqrt(static_cast<double>(idx));
+    }
+    sink += static_cast<std::uint64_t>(value);
+}
+
+struct counter_t {
+    std::atomic<std::size_t> left;
+    std::promise<void> done{};
+
+    explicit counter_t(std::size_t amount)
+        : left{amount}
+    {
+    }
+    void count_down()
+    {
+        if (--left == 0) {
+            done.set_value();
+        }
+    }
+};
+
+// все задачи кладёт внешний поток
+double run_external(
+    thread_pool_t::mode_t mode, uint threads_amount, std::size_t tasks_amount, std::size_t work)
+{
+    thread_pool_t thread_pool{threads_amount, mode};
+    thread_pool.init();
+    counter_t counter{tasks_amount};
+    auto done = counter.done.get_future();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto idx = 0u; idx < tasks_amount; ++idx) {
+        thread_pool.add_task([&counter, work]() {
+            do_work(work);
+            counter.count_down();
+        });
+    }
+    done.wait();
+    const auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(tasks_amount)
+        / std::chrono::duration<double>(end - start).count();
+}
+
+// несколько корневых задач порождают мелкие подзадачи изнутри пула
+double run_nested(
+    thread_pool_t::mode_t mode, uint threads_amount, std::size_t tasks_amount, std::size_t work)
+{
+    thread_pool_t thread_pool{threads_amount, mode};
+    thread_pool.init();
+    const auto children_amount = tasks_amount / roots_amount;
+    counter_t counter{roots_amount * children_amount};
+    auto done = counter.done.get_future();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto root = 0u; root < roots_amount; ++root) {
+        thread_pool.add_task([&thread_pool, &counter, work, children_amount]() {
+            for (auto idx = 0u; idx < children_amount; ++idx) {
+                thread_pool.add_task([&counter, work]() {
+                    do_work(work);
+                    counter.count_down();
+                });
+            }
+        });
+    }
+    done.wait();
+    const auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(roots_amount * children_amount)
+        / std::chrono::duration<double>(end - start).count();
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    cxxopts::Options options("pool_bench", "Throughput of thread_pool_t for fine-grained tasks.");
+
+    // clang-format off
+    options.add_options()
+        ("h,help", "Print help")
+        ("max-threads", "Largest amount of threads, amounts are doubled from 1", cxxopts::value<uint>()->default_value("64"))
+        ("tasks", "Amount of tasks per run", cxxopts::value<std::size_t>()->default_value("200000"))
+        ("work", "Iterations of busy work inside one task", cxxopts::value<std::size_t>()->default_value("200"));
+    // clang-format on
+
+    auto initOpts = options.parse(argc, argv);
+    if (initOpts.count("help")) {
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+    const auto max_threads = initOpts["max-threads"].as<uint>();
+    const auto tasks_amount = initOpts["tasks"].as<std::size_t>();
+    const auto work = initOpts["work"].as<std::size_t>();
+    // иначе счётчик задач сценария nested начинается с нуля и никогда не срабатывает
+    if (tasks_amount < roots_amount) {
+        std::cout << "tasks amount must be at least " << roots_amount << "\n";
+        exit(1);
+    }
+    if (max_threads == 0) {
+        std::cout << "max threads must be at least 1\n";
+        exit(1);
+    }
+
+    std::cout << std::setw(14) << "mode" << "\t" << std::setw(10) << "scenario" << "\t"
+              << std::setw(8) << "threads" << "\t" << std::setw(12) << "tasks/s" << "\n";
+    for (const auto mode : {thread_pool_t::mode_t::shared_queue, thread_pool_t::mode_t::work_stealing}) {
+        const std::string mode_name
+            = mode == thread_pool_t::mode_t::shared_queue ? "shared_queue" : "work_stealing";
+        for (uint threads_amount = 1; threads_amount <= max_threads;) {
+            const auto external = run_external(mode, threads_amount, tasks_amount, work);
+            std::cout << std::setw(14) << mode_name << "\t" << std::setw(10) << "external" << "\t"
+                      << std::setw(8) << threads_amount << "\t" << std::setw(12) << std::fixed
+                      << std::setprecision(0) << external << "\n";
+            const auto nested = run_nested(mode, threads_amount, tasks_amount, work);
+            std::cout << std::setw(14) << mode_name << "\t" << std::setw(10) << "nested" << "\t"
+                      << std::setw(8) << threads_amount << "\t" << std::setw(12) << std::fixed
+                      << std::setprecision(0) << nested << "\n";
+            // удвоение за max_threads переполнило бы uint при max_threads >= 2^31
+            if (threads_amount > max_threads / 2) {
+                break;
+            }
+            threads_amount *= 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+#ifndef PROGRESS_HPP_INCLUDED
+#define PROGRESS_HPP_INCLUDED
+
+#include "config.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace task {
+// фаза расчёта, с которой продолжается работа после восстановления
+enum class phase_t : std::uint8_t { prepare, dynamic, observation };
+
+inline std::string to_string(phase_t phase)
+{
+    switch (phase) {
+    case phase_t::prepare:
+        return "prepare";
+    case phase_t::dynamic:
+        return "dynamic";
+    case phase_t::observation:
+        return "observation";
+    }
+    return "unknown";
+}
+
+// Счётчики выполняемой конфигурации. Пишет только поток расчёта, читает поток отчёта,
+// поэтому достаточно relaxed: в отчёт могут попасть значения соседних шагов
+struct progress_t {
+    std::atomic<phase_t> phase{phase_t::prepare};
+    std::atomic<std::uint64_t> phase_begin{0}; // значение sweeps при входе в фазу
+    // шаг фазы при входе: после восстановления из контрольной точки он больше нуля,
+    // поэтому хранится отдельно, а не вычитается из phase_begin
+    std::atomic<std::uint64_t> phase_first_mcs{0};
+    std::atomic<std::uint64_t> sweeps{0};
+    std::atomic<std::uint64_t> transport_calls{0};
+
+    void enter(phase_t phase_, std::uint64_t first_mcs = 0) noexcept
+    {
+        phase_first_mcs.store(first_mcs, std::memory_order_relaxed);
+        phase_begin.store(sweeps.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        phase.store(phase_, std::memory_order_relaxed);
+    }
+    void addSweep() noexcept
+    {
+        sweeps.fetch_add(1, std::memory_order_relaxed);
+    }
+    void addTransportCalls(std::uint64_t amount) noexcept
+    {
+        transport_calls.fetch_add(amount, std::memory_order_relaxed);
+    }
+};
+
+// Таблица выполняемых конфигураций. Строка живёт, пока жив shared_ptr, выданный add.
+// Скорости считаются по приросту счётчиков между обновлениями: нулевая скорость у
+// выполняемой конфигурации означает, что она остановилась. Неизвестный ETA равен -1
+class progress_board_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    struct row_t {
+        std::string label;
+        phase_t phase;
+        std::uint64_t mcs;
+        double mcs_per_second;
+        double transport_per_second;
+        double eta_seconds;
+    };
+
+    std::shared_ptr<progress_t> add(std::string label)
+    {
+        auto progress = std::make_shared<progress_t>();
+        std::lock_guard lg{m_mutex};
+        m_entries.push_back({std::move(label), progress, 0, 0, clock_t::now()});
+        return progress;
+    }
+
+    std::vector<row_t> refresh()
+    {
+        const auto now = clock_t::now();
+        std::vector<row_t> rows{};
+        std::lock_guard lg{m_mutex};
+        m_entries.erase(
+            std::remove_if(
+                m_entries.begin(),
+                m_entries.end(),
+                [](const entry_t& entry) { return entry.progress.expired(); }),
+            m_entries.end());
+        for (auto& entry : m_entries) {
+            const auto progress = entry.progress.lock();
+            if (!progress) {
+                continue;
+            }
+            const auto phase = progress->phase.load(std::memory_order_relaxed);
+            const auto phase_begin = progress->phase_begin.load(std::memory_order_relaxed);
+            const auto first_mcs = progress->phase_first_mcs.load(std::memory_order_relaxed);
+            const auto sweeps = progress->sweeps.load(std::memory_order_relaxed);
+            const auto calls = progress->transport_calls.load(std::memory_order_relaxed);
+
+            const auto seconds = std::chrono::duration<double>(now - entry.last_time).count();
+            const auto mcs = first_mcs + (sweeps >= phase_begin ? sweeps - phase_begin : 0);
+            row_t row{entry.label, phase, mcs, 0.0, 0.0, -1.0};
+            if (seconds > 0.0) {
+                row.mcs_per_second = static_cast<double>(sweeps - entry.last_sweeps) / seconds;
+                row.transport_per_second
+                    = static_cast<double>(calls - entry.last_calls) / seconds;
+            }
+            row.eta_seconds = estimateLeft(row);
+            entry.last_sweeps = sweeps;
+            entry.last_calls = calls;
+            entry.last_time = now;
+            rows.push_back(std::move(row));
+        }
+        return rows;
+    }
+
+    static void print(std::ostream& out, const std::vector<row_t>& rows)
+    {
+        out << "config\tphase\tmcs\tmcs/s\ttransport/s\teta, s\n";
+        for (const auto& row : rows) {
+            out << row.label << "\t" << to_string(row.phase) << "\t" << row.mcs << "\t"
+                << std::fixed << std::setprecision(1) << row.mcs_per_second << "\t"
+                << row.transport_per_second << "\t" << std::setprecision(0) << row.eta_seconds
+                << "\n"
+                << std::defaultfloat;
+        }
+    }
+
+    // каждые interval обновляет таблицу, выводит её в out под out_mutex и переписывает
+    // status_path, последний раз - при остановке. Остальные потоки, пишущие в out, берут тот же
+    // out_mutex, иначе таблица перемешается с их строками. Файл заменяется через rename,
+    // поэтому читатель не увидит его недописанным
+    void startReporting(
+        std::chrono::seconds interval,
+        std::filesystem::path status_path,
+        std::ostream& out,
+        std::mutex& out_mutex)
+    {
+        m_reporter = std::thread{
+            [this, interval, status_path = std::move(status_path), &out, &out_mutex]() {
+                std::unique_lock ul{m_reporter_mutex};
+                for (bool is_terminated = false; !is_terminated;) {
+                    is_terminated
+                        = m_cv.wait_for(ul, interval, [this]() { return m_is_terminated; });
+                    const auto rows = refresh();
+                    auto tmp_path = status_path;
+                    tmp_path += ".tmp";
+                    {
+                        std::ofstream status_out{tmp_path};
+                        print(status_out, rows);
+                    }
+                    std::error_code error{};
+                    std::filesystem::rename(tmp_path, status_path, error);
+                    if (!is_terminated && !rows.empty()) {
+                        std::ostringstream table{};
+                        print(table, rows);
+                        std::lock_guard lg{out_mutex};
+                        out << table.str() << std::flush;
+                    }
+                }
+            }};
+    }
+
+    // после остановки out снова принадлежит одному вызывающему потоку
+    void stopReporting()
+    {
+        if (m_reporter.joinable()) {
+            {
+                std::lock_guard lg{m_reporter_mutex};
+                m_is_terminated = true;
+            }
+            m_cv.notify_all();
+            m_reporter.join();
+        }
+    }
+
+    ~progress_board_t()
+    {
+        stopReporting();
+    }
+
+private:
+    struct entry_t {
+        std::string label;
+        std::weak_ptr<progress_t> progress;
+        std::uint64_t last_sweeps;
+        std::uint64_t last_calls;
+        clock_t::time_point last_time;
+    };
+    std::vector<entry_t> m_entries{};
+    std::mutex m_mutex{};
+
+    std::thread m_reporter{};
+    std::mutex m_reporter_mutex{};
+    std::condition_variable m_cv{};
+    bool m_is_terminated = false;
+
+    // шаг наблюдения включает и транспорт, поэтому оставшееся время считается по скорости
+    // шагов после t_wait, до этого длина и цена оставшихся шагов заранее неизвестны
+    static double estimateLeft(const row_t& row)
+    {
+        const auto observation = base_config::mcs_observation + base_config::t_wait_vec.back();
+        if (row.phase != phase_t::observation || row.mcs <= base_config::t_wait_vec.front()
+            || row.mcs_per_second <= 0.0) {
+            return -1.0;
+        }
+        return static_cast<double>(observation - std::min(row.mcs, observation))
+            / row.mcs_per_second;
+    }
+};
+} // namespace task
+
+#endif
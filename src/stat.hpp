@@ -1,3 +1,6 @@
+#ifndef STAT_HPP_INCLUDED
+#define STAT_HPP_INCLUDED
+
 #include "config.hpp"
 #include "line_t.hpp"
 
@@ -9,7 +12,9 @@
 #include <fstream>
 #include <iostream>
 #include <optional>
+#include <sstream>
 #include <string>
+#include <vector>
 
 namespace stat {
 
@@ -23,24 +28,32 @@ struct stater {
                   << "\n";
         prepare_folder(path_to_result_folder, raw_data_folder);
 
-        auto init_configs = task::base_config::getConfigs();
-        std::vector<task::base_config::config_t> configs{};
-        for (auto&& elem : init_configs) {
-            if (elem.stat_id == 0) {
-                configs.push_back(std::move(elem));
+        for (const auto& name : getFileNames()) {
+            for (const auto& config : task::base_config::getConfigs()) {
+                if (config.stat_id == 0) {
+                    create_stat(name, config, path_to_result_folder, raw_data_folder);
+                }
             }
         }
-        create_stat("m", configs, path_to_result_folder, raw_data_folder);
-        create_stat("cos_theta", configs, path_to_result_folder, raw_data_folder);
-        create_stat("cos_thetaXZ", configs, path_to_result_folder, raw_data_folder);
-        create_stat("j", configs, path_to_result_folder, raw_data_folder);
-        create_stat("Nup", configs, path_to_result_folder, raw_data_folder);
-        create_stat("Ndown", configs, path_to_result_folder, raw_data_folder);
 
         std::cout << "Stat calculations ends"
                   << "\n";
     }
 
+    // Ниже - расчёты одной группы (N, T_creation, T_sample, h), config - любая её реплика.
+    // Они не меняют текущую папку процесса, поэтому группы можно считать параллельно
+    static void makeGroupStat(
+        const std::filesystem::path& path_to_result_folder,
+        std::string_view raw_data_folder,
+        const task::base_config::config_t& config)
+    {
+        std::filesystem::create_directories(
+            path_to_result_folder / stat_folder / task::createName(config));
+        for (const auto& name : getFileNames()) {
+            create_stat(name, config, path_to_result_folder, raw_data_folder);
+        }
+    }
+
     static void calcGMR(std::filesystem::path path_to_result_folder)
     {
         std::cout << "GMR calculations begins"
@@ -54,93 +67,7 @@ struct stater {
             }
         }
         for (const auto& config : configs) {
-            task::base_config::config_t config_0{
-                config.stat_id, config.N, config.T_creation, config.T_sample, {0.0, 0.0, 0.0}};
-
-            std::filesystem::current_path(path_to_result_folder / stat_folder);
-            auto j_file_0 = std::ifstream{
-                std::filesystem::current_path() / task::createName(config_0) / "j.txt"};
-
-            const auto folder_name = task::createName(config);
-            std::filesystem::current_path(std::filesystem::current_path() / folder_name);
-            auto j_file = std::ifstream{std::filesystem::current_path() / "j.txt"};
-
-            {
-                std::string j_file_head{};
-                std::string j_file_head_0{};
-                std::getline(j_file, j_file_head);
-                std::getline(j_file_0, j_file_head_0);
-            }
-
-            std::array<std::ofstream, task::base_config::t_wait_vec.size()> outers{};
-            for (auto tw_counter = 0u; tw_counter < task::base_config::t_wait_vec.size();
-                 ++tw_counter) {
-                outers[tw_counter].open(
-                    "MR_tw=" + std::to_string(task::base_config::t_wait_vec[tw_counter]) + ".txt");
-                outers[tw_counter] << "MR_h_lower_hc\t\tMR_h_upper_hc\t" << std::endl;
-            }
-            auto t_minus_tw_counter = 0u;
-            while (!j_file.eof() && !j_file_0.eof()) {
-                std::string line{};
-                if (get_line(j_file, line)) {
-                    break;
-                }
-                std::istringstream stream1{line};
-                const auto j_line = get_double_line(stream1);
-                auto j_up_h = j_line[0];
-                auto j_up_h_err = j_line[1];
-                auto j_down_h = j_line[2];
-                auto j_down_h_err = j_line[3];
-
-                if (get_line(j_file_0, line)) {
-                    break;
-                }
-                std::istringstream stream2{line};
-                const auto j_line_0 = get_double_line(stream2);
-                auto j_up_0 = j_line_0[0];
-                auto j_up_err_0 = j_line_0[1];
-                auto j_down_0 = j_line_0[2];
-                auto j_down_err_0 = j_line_0[3];
-
-                double GMR_h_lower_hc{};
-                double GMR_h_lower_hc_err{};
-                double GMR_h_upper_hc{};
-                double GMR_h_upper_hc_err{};
-
-                {
-                    GMR_h_lower_hc = (j_up_h + j_down_h) / (j_up_h * j_down_h) * (j_up_0 * j_down_0)
-                            / (j_up_0 + j_down_0)
-                        - 1.0;
-                    GMR_h_lower_hc_err = (GMR_h_lower_hc + 1.0)
-                        * ((j_up_h_err + j_down_h_err) / (j_up_h + j_down_h) + j_up_h_err / j_up_h
-                           + j_down_h_err / j_down_h + j_up_err_0 / j_up_0 + j_down_err_0 / j_down_0
-                           + (j_up_err_0 + j_down_err_0) / (j_up_0 + j_down_0));
-                    GMR_h_upper_hc
-                        = 4.0 * (j_up_0 * j_down_0) / ((j_up_h + j_down_h) * (j_up_0 + j_down_0))
-                        - 1.0;
-                    GMR_h_upper_hc_err = (GMR_h_upper_hc + 1.0)
-                        * (j_up_err_0 / j_up_0 + j_down_err_0 / j_down_0
-                           + (j_up_err_0 + j_down_err_0) / (j_up_0 + j_down_0)
-                           + (j_up_h_err + j_down_h_err) / (j_up_h + j_down_h));
-                }
-
-                for (auto tw_counter = 0u; tw_counter < task::base_config::t_wait_vec.size();
-                     ++tw_counter) {
-                    const auto mcs = task::base_config::t_wait_vec[tw_counter]
-                        - task::base_config::t_wait_vec[0];
-                    if (t_minus_tw_counter >= mcs) {
-                        outers[tw_counter] << std::setw(10) << GMR_h_lower_hc * 100 << '\t'
-                                           << std::setw(10) << GMR_h_lower_hc_err * 100 << '\t'
-                                           << std::setw(10) << GMR_h_upper_hc * 100 << '\t'
-                                           << std::setw(10) << GMR_h_upper_hc_err * 100 << '\n';
-                    }
-                }
-                t_minus_tw_counter++;
-            }
-            for (auto& outer : outers) {
-                outer.flush();
-                outer.close();
-            }
+            calcGroupGMR(path_to_result_folder, config);
         }
         std::cout << "MR calculations ends"
                   << "\n";
@@ -158,60 +85,177 @@ struct stater {
         }
 
         for (const auto& config : configs) {
-            const auto folder_name = task::createName(config);
-            std::filesystem::current_path(path_to_result_folder / stat_folder / folder_name);
+            calcGroupP(path_to_result_folder, config);
+        }
+
+        std::cout << "Polarization calculations ends\n";
+    }
+
+    // магнитосопротивление группы с полем h относительно группы с h = 0,
+    // у каждого t_wait - по токам своего набора реплик
+    static void calcGroupGMR(
+        const std::filesystem::path& path_to_result_folder,
+        const task::base_config::config_t& config)
+    {
+        for (const auto t_wait : task::base_config::t_wait_vec) {
+            calcGroupGMR(path_to_result_folder, config, t_wait);
+        }
+    }
+
+    // поляризация группы по Nup и Ndown каждого t_wait
+    static void calcGroupP(
+        const std::filesystem::path& path_to_result_folder,
+        const task::base_config::config_t& config)
+    {
+        for (const auto t_wait : task::base_config::t_wait_vec) {
+            calcGroupP(path_to_result_folder, config, t_wait);
+        }
+    }
+
+private:
+    static void calcGroupGMR(
+        const std::filesystem::path& path_to_result_folder,
+        const task::base_config::config_t& config,
+        unsigned t_wait)
+    {
+        task::base_config::config_t config_0{
+            config.stat_id, config.N, config.T_creation, config.T_sample, {0.0, 0.0, 0.0}};
+
+        const auto j_name = task::createTransportName("j", t_wait) + ".txt";
+        const auto stat_path = path_to_result_folder / stat_folder;
+        auto j_file_0 = std::ifstream{stat_path / task::createName(config_0) / j_name};
+
+        const auto folder_path = stat_path / task::createName(config);
+        auto j_file = std::ifstream{folder_path / j_name};
+
+        {
+            std::string j_file_head{};
+            std::string j_file_head_0{};
+            std::getline(j_file, j_file_head);
+            std::getline(j_file_0, j_file_head_0);
+        }
+
+        std::ofstream outer{folder_path / ("MR_tw=" + std::to_string(t_wait) + ".txt")};
+        outer << "MR_h_lower_hc\t\tMR_h_upper_hc\t" << std::endl;
+        while (!j_file.eof() && !j_file_0.eof()) {
+            std::string line{};
+            if (get_line(j_file, line)) {
+                break;
+            }
+            std::istringstream stream1{line};
+            const auto j_line = get_double_line(stream1);
+            auto j_up_h = j_line[0];
+            auto j_up_h_err = j_line[1];
+            auto j_down_h = j_line[2];
+            auto j_down_h_err = j_line[3];
+
+            if (get_line(j_file_0, line)) {
+                break;
+            }
+            std::istringstream stream2{line};
+            const auto j_line_0 = get_double_line(stream2);
+            auto j_up_0 = j_line_0[0];
+            auto j_up_err_0 = j_line_0[1];
+            auto j_down_0 = j_line_0[2];
+            auto j_down_err_0 = j_line_0[3];
+
+            double GMR_h_lower_hc{};
+            double GMR_h_lower_hc_err{};
+            double GMR_h_upper_hc{};
+            double GMR_h_upper_hc_err{};
 
-            auto Nup_in = std::ifstream{std::filesystem::current_path() / "Nup.txt"};
-            auto Ndown_in = std::ifstream{std::filesystem::current_path() / "Ndown.txt"};
             {
-                std::string head{};
-                std::getline(Nup_in, head);
-                std::getline(Ndown_in, head);
+                GMR_h_lower_hc = (j_up_h + j_down_h) / (j_up_h * j_down_h) * (j_up_0 * j_down_0)
+                        / (j_up_0 + j_down_0)
+                    - 1.0;
+                GMR_h_lower_hc_err = (GMR_h_lower_hc + 1.0)
+                    * ((j_up_h_err + j_down_h_err) / (j_up_h + j_down_h) + j_up_h_err / j_up_h
+                       + j_down_h_err / j_down_h + j_up_err_0 / j_up_0 + j_down_err_0 / j_down_0
+                       + (j_up_err_0 + j_down_err_0) / (j_up_0 + j_down_0));
+                GMR_h_upper_hc
+                    = 4.0 * (j_up_0 * j_down_0) / ((j_up_h + j_down_h) * (j_up_0 + j_down_0))
+                    - 1.0;
+                GMR_h_upper_hc_err = (GMR_h_upper_hc + 1.0)
+                    * (j_up_err_0 / j_up_0 + j_down_err_0 / j_down_0
+                       + (j_up_err_0 + j_down_err_0) / (j_up_0 + j_down_0)
+                       + (j_up_h_err + j_down_h_err) / (j_up_h + j_down_h));
             }
-            std::ofstream out{"P.txt"};
-            std::ofstream out_mod{"P_mod.txt"};
-            out << "P_1\t\tP_2\t\n";
-            out_mod << "P_1\t\tP_2\t\n";
-
-            while (!Nup_in.eof() && !Ndown_in.eof()) {
-                std::string up_line{};
-                std::string down_line{};
-                if (get_line(Nup_in, up_line)) {
-                    break;
-                }
-                if (get_line(Ndown_in, down_line)) {
-                    break;
-                }
-                const auto [up1, up1_err, up2, up2_err] = parse_line<4>(up_line);
-                const auto [down1, down1_err, down2, down2_err] = parse_line<4>(down_line);
-
-                const auto _P1 = (up1 - down1) / (up1 + down1);
-                const auto _P1_err
-                    = (up1_err + down1_err) / (up1 - down1) + (up1_err + down1_err) / (up1 + down1);
-                const auto _P2 = (up2 - down2) / (up2 + down2);
-                const auto _P2_err
-                    = (up2_err + down2_err) / (up2 - down2) + (up2_err + down2_err) / (up2 + down2);
-
-                const auto P1 = _P1 * task::base_config::A_fb;
-                const auto P1_err = _P1_err * task::base_config::A_fb;
-                const auto P2 = _P2 * task::base_config::A_fb;
-                const auto P2_err = _P2_err * task::base_config::A_fb;
-
-                out << std::setw(10) << _P1 << "\t" << std::setw(10) << std::abs(_P1_err) << "\t"
-                    << std::setw(10) << _P2 << "\t" << std::setw(10) << std::abs(_P2_err) << "\n";
-                out_mod << std::setw(10) << P1 << "\t" << std::setw(10) << std::abs(P1_err) << "\t"
-                        << std::setw(10) << P2 << "\t" << std::setw(10) << std::abs(P2_err) << "\n";
+
+            outer << std::setw(10) << GMR_h_lower_hc * 100 << '\t' << std::setw(10)
+                  << GMR_h_lower_hc_err * 100 << '\t' << std::setw(10) << GMR_h_upper_hc * 100
+                  << '\t' << std::setw(10) << GMR_h_upper_hc_err * 100 << '\n';
+        }
+        outer.flush();
+        outer.close();
+    }
+
+    static void calcGroupP(
+        const std::filesystem::path& path_to_result_folder,
+        const task::base_config::config_t& config,
+        unsigned t_wait)
+    {
+        const auto folder_path = path_to_result_folder / stat_folder / task::createName(config);
+        auto Nup_in
+            = std::ifstream{folder_path / (task::createTransportName("Nup", t_wait) + ".txt")};
+        auto Ndown_in
+            = std::ifstream{folder_path / (task::createTransportName("Ndown", t_wait) + ".txt")};
+        {
+            std::string head{};
+            std::getline(Nup_in, head);
+            std::getline(Ndown_in, head);
+        }
+        std::ofstream out{folder_path / (task::createTransportName("P", t_wait) + ".txt")};
+        std::ofstream out_mod{folder_path / (task::createTransportName("P_mod", t_wait) + ".txt")};
+        out << "P_1\t\tP_2\t\n";
+        out_mod << "P_1\t\tP_2\t\n";
+
+        while (!Nup_in.eof() && !Ndown_in.eof()) {
+            std::string up_line{};
+            std::string down_line{};
+            if (get_line(Nup_in, up_line)) {
+                break;
             }
-            out.flush();
-            out_mod.flush();
-            out.close();
-            out_mod.close();
+            if (get_line(Ndown_in, down_line)) {
+                break;
+            }
+            const auto [up1, up1_err, up2, up2_err] = parse_line<4>(up_line);
+            const auto [down1, down1_err, down2, down2_err] = parse_line<4>(down_line);
+
+            const auto _P1 = (up1 - down1) / (up1 + down1);
+            const auto _P1_err
+                = (up1_err + down1_err) / (up1 - down1) + (up1_err + down1_err) / (up1 + down1);
+            const auto _P2 = (up2 - down2) / (up2 + down2);
+            const auto _P2_err
+                = (up2_err + down2_err) / (up2 - down2) + (up2_err + down2_err) / (up2 + down2);
+
+            const auto P1 = _P1 * task::base_config::A_fb;
+            const auto P1_err = _P1_err * task::base_config::A_fb;
+            const auto P2 = _P2 * task::base_config::A_fb;
+            const auto P2_err = _P2_err * task::base_config::A_fb;
+
+            out << std::setw(10) << _P1 << "\t" << std::setw(10) << std::abs(_P1_err) << "\t"
+                << std::setw(10) << _P2 << "\t" << std::setw(10) << std::abs(_P2_err) << "\n";
+            out_mod << std::setw(10) << P1 << "\t" << std::setw(10) << std::abs(P1_err) << "\t"
+                    << std::setw(10) << P2 << "\t" << std::setw(10) << std::abs(P2_err) << "\n";
         }
+        out.flush();
+        out_mod.flush();
+        out.close();
+        out_mod.close();
+    }
 
-        std::cout << "Polarization calculations ends\n";
+    // усредняемые файлы: спиновые общие на траекторию, транспорт - свой у каждого t_wait
+    static std::vector<std::string> getFileNames()
+    {
+        std::vector<std::string> names{"m", "cos_theta", "cos_thetaXZ"};
+        for (const auto t_wait : task::base_config::t_wait_vec) {
+            for (const auto* name : {"j", "Nup", "Ndown"}) {
+                names.push_back(task::createTransportName(name, t_wait));
+            }
+        }
+        return names;
     }
 
-private:
     template<int amount>
     static std::array<double, amount> parse_line(const std::string& line)
     {
@@ -239,94 +283,83 @@ private:
     }
     // template <std::uint16_t stat_amount = task::base_config::m_stat_amount * task::base_config::j_stat_amount>
     static void create_stat(
-        std::string&& name,
-        const std::vector<task::base_config::config_t>& configs,
-        std::filesystem::path path_to_result_folder,
+        std::string_view name,
+        const task::base_config::config_t& config,
+        const std::filesystem::path& path_to_result_folder,
         std::string_view raw_data_folder)
     {
         std::vector<std::ifstream> input_streams{};
-        for (const auto& config : configs) {
-            input_streams.clear();
-            namespace fs = std::filesystem;
-            const auto folder_name = task::createName(config);
-            const auto path_to_file = path_to_result_folder / raw_data_folder / folder_name;
+        const auto folder_name = task::createName(config);
+        const auto path_to_file = path_to_result_folder / raw_data_folder / folder_name;
 
-            {
-                using std::filesystem::exists;
-                auto idx = 0u;
-                while (exists(path_to_file / create_file_name(name, idx))) {
-                    input_streams.push_back(
-                        std::ifstream(path_to_file / create_file_name(name, idx)));
-                    idx++;
-                }
+        {
+            using std::filesystem::exists;
+            auto idx = 0u;
+            while (exists(path_to_file / create_file_name(std::string{name}, idx))) {
+                input_streams.push_back(
+                    std::ifstream(path_to_file / create_file_name(std::string{name}, idx)));
+                idx++;
             }
+        }
 
-            const auto init_head = remove_heads(input_streams.begin(), input_streams.end());
-
-            auto is_end = [&input_streams]() noexcept -> bool {
-                bool res = false;
-                std::for_each(
-                    input_streams.begin(),
-                    input_streams.end(),
-                    [&res](auto& elem) noexcept -> void { res += elem.eof(); });
-                return res;
-            };
-
-            try{
-                fs::current_path(path_to_result_folder / stat_folder / folder_name);
-            } catch(std::exception& e) {
-                std::cout << path_to_result_folder / stat_folder / folder_name << std::endl;
-                throw;
-            }
-            std::cout << "\t" << fs::current_path().string() << "/" << name
-                      << " file stat begins\n";
-            std::ofstream out{name + ".txt"};
-            {
-                std::istringstream init_head_stream{init_head};
-                for (std::string elem; std::getline(init_head_stream, elem, '\t');) {
-                    out << std::setw(10) << elem << "\t\t";
-                }
-                out << "\n";
+        const auto init_head = remove_heads(input_streams.begin(), input_streams.end());
+
+        auto is_end = [&input_streams]() noexcept -> bool {
+            bool res = false;
+            std::for_each(
+                input_streams.begin(),
+                input_streams.end(),
+                [&res](auto& elem) noexcept -> void { res += elem.eof(); });
+            return res;
+        };
+
+        const auto stat_path = (path_to_result_folder / stat_folder / folder_name).string();
+        std::cout << "\t" + stat_path + "/" + std::string{name} + " file stat begins\n";
+        std::ofstream out{stat_path + "/" + std::string{name} + ".txt"};
+        {
+            std::istringstream init_head_stream{init_head};
+            for (std::string elem; std::getline(init_head_stream, elem, '\t');) {
+                out << std::setw(10) << elem << "\t\t";
             }
+            out << "\n";
+        }
 
-            std::vector<std::optional<line_t>> buf(input_streams.size());
-            while (!is_end()) {
-                get_values_from_streams(input_streams.begin(), input_streams.end(), buf);
-
-                line_t average{};
-                auto amount = 0u;
-                for (const auto& elem : buf) {
-                    if (elem) {
-                        average += elem.value();
-                        amount++;
-                    }
-                }
-                average /= amount;
-                line_t err{};
-                for (const auto& elem : buf) {
-                    if (elem) {
-                        err += stat::sqr(elem.value() - average);
-                    }
-                }
-                err /= amount;
+        std::vector<std::optional<line_t>> buf(input_streams.size());
+        while (!is_end()) {
+            get_values_from_streams(input_streams.begin(), input_streams.end(), buf);
 
-                for (auto idx = 0u; idx < average.size(); ++idx) {
-                    out << std::setw(10) << average[idx] << '\t' << std::setw(10) << err[idx]
-                        << '\t';
+            line_t average{};
+            auto amount = 0u;
+            for (const auto& elem : buf) {
+                if (elem) {
+                    average += elem.value();
+                    amount++;
                 }
-                out << '\n';
             }
-            out.flush();
-            out.close();
+            average /= amount;
+            line_t err{};
+            for (const auto& elem : buf) {
+                if (elem) {
+                    err += stat::sqr(elem.value() - average);
+                }
+            }
+            err /= amount;
 
-            std::cout << '\t' << fs::current_path().string() << '/' << name << " file stat ends\n";
+            for (auto idx = 0u; idx < average.size(); ++idx) {
+                out << std::setw(10) << average[idx] << '\t' << std::setw(10) << err[idx]
+                    << '\t';
+            }
+            out << '\n';
         }
+        out.flush();
+        out.close();
+
+        std::cout << "\t" + stat_path + "/" + std::string{name} + " file stat ends\n";
     }
 
     static line_t get_double_line(std::istream& stream) noexcept
     {
-        static line_t buf_line{};
-        buf_line.clear();
+        line_t buf_line{};
         for (std::string data; std::getline(stream, data, '\t');) {
             double value{};
             try {
@@ -404,3 +437,5 @@ private:
     }
 };
 } // namespace stat
+
+#endif
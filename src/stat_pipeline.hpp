@@ -0,0 +1,171 @@
+#ifndef STAT_PIPELINE_HPP_INCLUDED
+#define STAT_PIPELINE_HPP_INCLUDED
+
+#include "config.hpp"
+#include "stat.hpp"
+#include "thread_pool.hpp"
+
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace stat {
+// Статистика по мере готовности групп (N, T_creation, T_sample, h). Как только посчитаны все
+// m_stat_amount реплик группы, её create_stat ставится в пул, за ним - поляризация группы.
+// GMR группы с h != 0 ставится, когда обработаны и она, и группа с h = 0 тех же N и T.
+// Задачи идут в пул впереди расчётов, поэтому занимают первый освободившийся поток
+class stat_pipeline_t {
+public:
+    stat_pipeline_t(
+        thread_pool_t& pool,
+        std::filesystem::path path_to_result_folder,
+        std::string_view raw_data_folder)
+        : m_pool{pool}
+        , m_result_folder{std::move(path_to_result_folder)}
+        , m_raw_data_folder{raw_data_folder}
+    {
+        for (const auto& config : task::base_config::getConfigs()) {
+            if (config.stat_id == 0) {
+                m_groups.emplace(task::createName(config), group_t{config});
+            }
+        }
+    }
+    stat_pipeline_t(const stat_pipeline_t&) = delete;
+    stat_pipeline_t& operator=(const stat_pipeline_t&) = delete;
+
+    ~stat_pipeline_t()
+    {
+        try {
+            wait();
+        } catch (...) {
+        }
+    }
+
+    // конфигурация посчитана, вызывается из одного потока
+    void completed(const task::base_config::config_t& config)
+    {
+        std::lock_guard lg{m_mutex};
+        auto& group = m_groups.at(task::createName(config));
+        if (++group.calculated == task::base_config::m_stat_amount) {
+            submit(group.config, [this](const task::base_config::config_t& group_config) {
+                stater::makeGroupStat(m_result_folder, m_raw_data_folder, group_config);
+                onGroupStat(group_config);
+            });
+        }
+    }
+
+    std::size_t get_processed_amount() const
+    {
+        std::lock_guard lg{m_mutex};
+        std::size_t amount = 0;
+        for (const auto& [name, group] : m_groups) {
+            amount += group.is_processed;
+        }
+        return amount;
+    }
+
+    // ждёт все поставленные задачи, в том числе поставленные по ходу ожидания,
+    // и пробрасывает первое исключение из них
+    void wait()
+    {
+        std::exception_ptr error{};
+        for (;;) {
+            std::vector<std::future<void>> futures{};
+            {
+                std::lock_guard lg{m_mutex};
+                futures.swap(m_futures);
+            }
+            if (futures.empty()) {
+                break;
+            }
+            for (auto& future : futures) {
+                try {
+                    future.get();
+                } catch (...) {
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct group_t {
+        task::base_config::config_t config;
+        unsigned calculated = 0;
+        bool is_processed = false;
+    };
+
+    thread_pool_t& m_pool;
+    const std::filesystem::path m_result_folder;
+    const std::string_view m_raw_data_folder;
+    std::map<std::string, group_t> m_groups{};
+    std::vector<std::future<void>> m_futures{};
+    mutable std::mutex m_mutex{};
+
+    static task::base_config::config_t zeroFieldOf(const task::base_config::config_t& config)
+    {
+        return {config.stat_id, config.N, config.T_creation, config.T_sample, {0.0, 0.0, 0.0}};
+    }
+
+    static bool isZeroField(const task::base_config::config_t& config)
+    {
+        return is_almost_equals(config.field, {0.0, 0.0, 0.0});
+    }
+
+    // вызывается под m_mutex
+    template<typename F>
+    void submit(const task::base_config::config_t& config, F&& f)
+    {
+        const thread_pool_t::task_info_t info{
+            std::numeric_limits<double>::max(), {}, 0, "stat of " + task::createName(config)};
+        m_futures.push_back(m_pool.add_task(info, std::forward<F>(f), config));
+    }
+
+    void submitGMR(const task::base_config::config_t& config)
+    {
+        submit(config, [this](const task::base_config::config_t& group_config) {
+            stater::calcGroupGMR(m_result_folder, group_config);
+        });
+    }
+
+    // отметка и проверка пары h, 0 идут под одной блокировкой, поэтому GMR группы ставится
+    // ровно один раз, какая бы из двух групп ни была обработана последней
+    void onGroupStat(const task::base_config::config_t& config)
+    {
+        std::lock_guard lg{m_mutex};
+        m_groups.at(task::createName(config)).is_processed = true;
+        submit(config, [this](const task::base_config::config_t& group_config) {
+            stater::calcGroupP(m_result_folder, group_config);
+        });
+        if (!isZeroField(config)) {
+            // без группы h = 0 в развёртке GMR считается, как и в calcGMR, по пустому файлу
+            const auto zero = m_groups.find(task::createName(zeroFieldOf(config)));
+            if (zero == m_groups.end() || zero->second.is_processed) {
+                submitGMR(config);
+            }
+            return;
+        }
+        for (const auto& [name, group] : m_groups) {
+            if (group.is_processed && !isZeroField(group.config) && group.config.N == config.N
+                && group.config.T_creation == config.T_creation
+                && group.config.T_sample == config.T_sample) {
+                submitGMR(group.config);
+            }
+        }
+    }
+};
+} // namespace stat
+
+#endif
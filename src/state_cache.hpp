@@ -0,0 +1,167 @@
+#ifndef STATE_CACHE_HPP_INCLUDED
+#define STATE_CACHE_HPP_INCLUDED
+
+#include "checkpoint.hpp"
+#include "config.hpp"
+#include "lattice_access.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <unistd.h>
+
+namespace task {
+// Кэш подготовленных образцов: состояние решётки после prepare при T_creation. Ключ -
+// (L, N, Delta, J2, T_creation, h, seed), seed - номер реплики stat_id, поэтому реплики одной
+// точки остаются независимыми, а повторные развёртки и конфигурации, отличающиеся только
+// T_sample, начинают сразу с динамической стадии. Электронная плотность до наблюдения не
+// меняется и в кэш не входит. Точные значения ключа хранятся в файле и сверяются при чтении
+class state_cache_t {
+public:
+    // сведения о подготовке, сохранённые вместе с состоянием
+    struct entry_t {
+        std::uint64_t init_mcs = 0; // счётчик "Initialization stage duration", не число шагов
+        double prepare_seconds = 0.0;
+    };
+
+    explicit state_cache_t(std::filesystem::path dir)
+        : m_dir{std::move(dir)}
+    {
+        std::filesystem::create_directories(m_dir);
+    }
+
+    const std::filesystem::path& getFolder() const noexcept
+    {
+        return m_dir;
+    }
+
+    std::filesystem::path getPath(const base_config::config_t& config) const
+    {
+        std::ostringstream name{};
+        name << std::setprecision(std::numeric_limits<double>::digits10) << "L=" << base_config::L
+             << "_N=" << std::to_string(config.N) << "_Delta=" << base_config::getDelta(config.N)
+             << "_J2=" << base_config::J2 << "_Tc=" << config.T_creation << "_h=" << config.field.x
+             << "," << config.field.y << "," << config.field.z << "_seed=" << config.stat_id
+             << ".bin";
+        return m_dir / name.str();
+    }
+
+    // при промахе или несовпадении ключа образец не меняется
+    template<typename Sample>
+    bool load(const base_config::config_t& config, Sample& sample, entry_t& entry)
+    {
+        const auto path = getPath(config);
+        if (!std::filesystem::exists(path)) {
+            m_misses++;
+            return false;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            binary_reader_t reader{path};
+            if (reader.read<std::array<char, 8>>() != magic
+                || reader.read<std::uint32_t>() != version || !isSameKey(reader, config)) {
+                m_misses++;
+                return false;
+            }
+            entry.init_mcs = reader.read<std::uint64_t>();
+            entry.prepare_seconds = reader.read<double>();
+            // файл читается в копию, чтобы обрезанный файл не оставил образец наполовину
+            // прочитанным, и переносится в решётку образца поэлементно
+            auto lattice = sample.lattice;
+            readLatticeState(reader, lattice);
+            copyLatticeState(lattice, sample.lattice);
+        } catch (const checkpoint_exception&) {
+            m_misses++;
+            return false;
+        }
+        const auto load_seconds
+            = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        m_hits++;
+        addSaved(entry.prepare_seconds - load_seconds);
+        return true;
+    }
+
+    // файл пишется во временный, своё имя которого у каждого потока каждого процесса,
+    // и переименовывается: одновременная запись одного ключа оставляет одну целую копию
+    template<typename Sample>
+    void store(const base_config::config_t& config, const Sample& sample, const entry_t& entry)
+    {
+        const auto path = getPath(config);
+        auto temp_path = path;
+        temp_path += ".tmp." + std::to_string(getpid()) + "."
+            + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            binary_writer_t writer{temp_path};
+            writer.write(magic).write(version);
+            writeKey(writer, config);
+            writer.write(entry.init_mcs).write(entry.prepare_seconds);
+            writeLatticeState(writer, sample.lattice);
+            writer.close();
+        }
+        std::filesystem::rename(temp_path, path);
+        m_stored++;
+    }
+
+    void report(std::ostream& out) const
+    {
+        out << "state cache " << m_dir.string() << " : " << m_hits.load() << " hits, "
+            << m_misses.load() << " misses, " << m_stored.load() << " stored, "
+            << m_saved_seconds.load() << " s of preparation saved\n";
+    }
+
+private:
+    constexpr static std::array<char, 8> magic{'G', 'M', 'R', 'S', 'T', 'A', 'T', 'E'};
+    constexpr static std::uint32_t version = 2;
+
+    std::filesystem::path m_dir;
+    std::atomic<std::uint64_t> m_hits{0};
+    std::atomic<std::uint64_t> m_misses{0};
+    std::atomic<std::uint64_t> m_stored{0};
+    std::atomic<double> m_saved_seconds{0.0};
+
+    void addSaved(double seconds) noexcept
+    {
+        auto current = m_saved_seconds.load();
+        while (!m_saved_seconds.compare_exchange_weak(current, current + seconds)) {
+        }
+    }
+
+    static void writeKey(binary_writer_t& writer, const base_config::config_t& config)
+    {
+        writer.write(base_config::L)
+            .write(config.N)
+            .write(base_config::getDelta(config.N))
+            .write(base_config::J2)
+            .write(config.T_creation)
+            .write(config.field)
+            .write(config.stat_id);
+    }
+
+    static bool isSameKey(binary_reader_t& reader, const base_config::config_t& config)
+    {
+        const auto L = reader.read<std::uint16_t>();
+        const auto N = reader.read<std::uint8_t>();
+        const auto Delta = reader.read<double>();
+        const auto J2 = reader.read<double>();
+        const auto T_creation = reader.read<double>();
+        const auto field = reader.read_magn();
+        const auto seed = reader.read<std::uint16_t>();
+        return L == base_config::L && N == config.N && Delta == base_config::getDelta(config.N)
+            && J2 == base_config::J2 && T_creation == config.T_creation
+            && is_almost_equals(field, config.field) && seed == config.stat_id;
+    }
+};
+} // namespace task
+
+#endif
@@ -0,0 +1,352 @@
+#ifndef SWEEP_HPP_INCLUDED
+#define SWEEP_HPP_INCLUDED
+
+#include "config.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+// Файл развёртки - подмножество TOML: строки "ключ = значение", комментарии с '#',
+// значение - число или массив в квадратных скобках (может занимать несколько строк).
+// Поле задаётся числом h (тогда это {h, 0, 0}) или массивом [x, y, z]:
+//
+//   L = 64
+//   m_stat_amount = 10
+//   j_stat_amount = 50
+//   mcs_init = 500
+//   mcs_observation = 5000
+//   N_size_vec = [3, 5, 7]
+//   T_creation_vec = [0.67]
+//   T_sample_vec = [0.95]
+//   t_wait_vec = [0]
+//   magn_field_vec = [0.0, 0.5, [1.0, 0.0, 0.0]]
+//
+// Отсутствующие ключи сохраняют значения по умолчанию из base_config.
+namespace task {
+struct sweep_exception : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+struct sweep_value_t {
+    bool is_array = false;
+    double number = 0.0;
+    std::vector<sweep_value_t> items{};
+};
+
+class sweep_parser_t {
+    const std::string& text;
+    std::size_t pos = 0;
+    const std::string& key;
+
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        throw sweep_exception{"Sweep key " + key + " : " + message};
+    }
+    void skip_spaces() noexcept
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            ++pos;
+        }
+    }
+
+public:
+    sweep_parser_t(const std::string& text_, const std::string& key_) noexcept
+        : text{text_}
+        , key{key_}
+    {
+    }
+
+    sweep_value_t parse()
+    {
+        auto value = parse_value();
+        skip_spaces();
+        if (pos != text.size()) {
+            fail("unexpected '" + text.substr(pos) + "'");
+        }
+        return value;
+    }
+
+    sweep_value_t parse_value()
+    {
+        skip_spaces();
+        if (pos == text.size()) {
+            fail("value expected");
+        }
+        sweep_value_t value{};
+        if (text[pos] != '[') {
+            std::size_t length = 0;
+            try {
+                value.number = std::stod(text.substr(pos), &length);
+            } catch (const std::logic_error&) {
+                fail("number expected at '" + text.substr(pos) + "'");
+            }
+            pos += length;
+            return value;
+        }
+        value.is_array = true;
+        ++pos;
+        for (skip_spaces(); pos < text.size() && text[pos] != ']'; skip_spaces()) {
+            value.items.push_back(parse_value());
+            skip_spaces();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+            } else if (pos < text.size() && text[pos] != ']') {
+                fail("',' or ']' expected");
+            }
+        }
+        if (pos == text.size()) {
+            fail("']' expected");
+        }
+        ++pos;
+        return value;
+    }
+};
+
+inline double toNumber(const sweep_value_t& value, const std::string& key)
+{
+    if (value.is_array) {
+        throw sweep_exception{"Sweep key " + key + " : number expected"};
+    }
+    return value.number;
+}
+
+template<typename Integer>
+Integer toInteger(const sweep_value_t& value, const std::string& key)
+{
+    const auto number = toNumber(value, key);
+    if (number < 0.0 || number != std::floor(number)
+        || number > static_cast<double>(std::numeric_limits<Integer>::max())) {
+        throw sweep_exception{"Sweep key " + key + " : non-negative integer expected"};
+    }
+    return static_cast<Integer>(number);
+}
+
+template<typename T, typename Convert>
+std::vector<T> toVector(const sweep_value_t& value, const std::string& key, Convert&& convert)
+{
+    if (!value.is_array || value.items.empty()) {
+        throw sweep_exception{"Sweep key " + key + " : non-empty array expected"};
+    }
+    std::vector<T> result{};
+    for (const auto& item : value.items) {
+        result.push_back(convert(item, key));
+    }
+    return result;
+}
+
+inline base_config::magn_t toField(const sweep_value_t& value, const std::string& key)
+{
+    if (!value.is_array) {
+        return {value.number, 0.0, 0.0};
+    }
+    if (value.items.size() != 3) {
+        throw sweep_exception{"Sweep key " + key + " : field must be h or [x, y, z]"};
+    }
+    return {
+        toNumber(value.items[0], key), toNumber(value.items[1], key), toNumber(value.items[2], key)};
+}
+
+inline void assign(const std::string& key, const sweep_value_t& value)
+{
+    if (key == "L") {
+        base_config::L = toInteger<std::uint16_t>(value, key);
+    } else if (key == "m_stat_amount") {
+        base_config::m_stat_amount = toInteger<std::uint16_t>(value, key);
+    } else if (key == "j_stat_amount") {
+        base_config::j_stat_amount = toInteger<std::uint16_t>(value, key);
+    } else if (key == "mcs_init") {
+        base_config::mcs_init = toInteger<std::uint64_t>(value, key);
+    } else if (key == "mcs_observation") {
+        base_config::mcs_observation = toInteger<std::uint64_t>(value, key);
+    } else if (key == "N_size_vec") {
+        base_config::N_size_vec = toVector<unsigned>(value, key, toInteger<unsigned>);
+    } else if (key == "T_creation_vec") {
+        base_config::T_creation_vec = toVector<double>(value, key, toNumber);
+    } else if (key == "T_sample_vec") {
+        base_config::T_sample_vec = toVector<double>(value, key, toNumber);
+    } else if (key == "t_wait_vec") {
+        base_config::t_wait_vec = toVector<unsigned>(value, key, toInteger<unsigned>);
+    } else if (key == "magn_field_vec") {
+        base_config::magn_field_vec = toVector<base_config::magn_t>(value, key, toField);
+    } else {
+        throw sweep_exception{"Unknown sweep key : " + key};
+    }
+}
+
+inline void validateSweep()
+{
+    if (std::find(base_config::L_menu.begin(), base_config::L_menu.end(), base_config::L)
+        == base_config::L_menu.end()) {
+        throw sweep_exception{
+            "L = " + std::to_string(base_config::L) + " is not one of ["
+            + values_as_string(base_config::L_menu.begin(), base_config::L_menu.end()) + "]"};
+    }
+    for (const auto N : base_config::N_size_vec) {
+        if (N == 0 || N > base_config::deltas.size()) {
+            throw sweep_exception{
+                "N = " + std::to_string(N) + " is out of [1, "
+                + std::to_string(base_config::deltas.size()) + "]"};
+        }
+    }
+    // шаг Метрополиса и лестница обмена реплик считают 1 / T
+    auto check_temperatures = [](const std::string& name, const std::vector<double>& values) {
+        for (const auto T : values) {
+            if (!(T > 0.0)) {
+                throw sweep_exception{name + " = " + std::to_string(T) + " must be positive"};
+            }
+        }
+    };
+    check_temperatures("T_creation", base_config::T_creation_vec);
+    check_temperatures("T_sample", base_config::T_sample_vec);
+    // у каждого t_wait свои файлы, поэтому повторы недопустимы
+    if (!std::is_sorted(base_config::t_wait_vec.begin(), base_config::t_wait_vec.end())
+        || std::adjacent_find(base_config::t_wait_vec.begin(), base_config::t_wait_vec.end())
+            != base_config::t_wait_vec.end()) {
+        throw sweep_exception{"t_wait_vec must be sorted and without repeats"};
+    }
+    if (base_config::m_stat_amount == 0 || base_config::j_stat_amount == 0) {
+        throw sweep_exception{"m_stat_amount and j_stat_amount must be positive"};
+    }
+    if (base_config::mcs_init < 2) {
+        throw sweep_exception{"mcs_init must be at least 2"};
+    }
+}
+
+inline std::string strip_comment(const std::string& line)
+{
+    return line.substr(0, line.find('#'));
+}
+} // namespace detail
+
+inline void loadSweep(const std::filesystem::path& path)
+{
+    std::ifstream in{path};
+    if (!in) {
+        throw sweep_exception{"Can not open sweep file " + path.string()};
+    }
+    std::string pending{};
+    for (std::string line; std::getline(in, line);) {
+        pending += detail::strip_comment(line) + "\n";
+        // массив может продолжаться на следующих строках
+        if (std::count(pending.begin(), pending.end(), '[')
+            > std::count(pending.begin(), pending.end(), ']')) {
+            continue;
+        }
+        const auto eq = pending.find('=');
+        if (eq == std::string::npos) {
+            if (pending.find_first_not_of(" \t\r\n") != std::string::npos) {
+                throw sweep_exception{"'key = value' expected : " + pending};
+            }
+            pending.clear();
+            continue;
+        }
+        auto key = pending.substr(0, eq);
+        key.erase(
+            std::remove_if(
+                key.begin(),
+                key.end(),
+                [](unsigned char symbol) { return std::isspace(symbol) || symbol == '"'; }),
+            key.end());
+        const auto value_text = pending.substr(eq + 1);
+        detail::assign(key, detail::sweep_parser_t{value_text, key}.parse());
+        pending.clear();
+    }
+    if (pending.find_first_not_of(" \t\r\n") != std::string::npos) {
+        throw sweep_exception{"Unterminated value in sweep file : " + pending};
+    }
+    detail::validateSweep();
+}
+
+// пишет текущую развёртку в том же формате, чтобы stat и --resume читали её из папки данных
+inline void writeSweep(std::ostream& out)
+{
+    auto list = [&out](const auto& values) {
+        out << "[";
+        for (auto idx = 0u; idx < values.size(); ++idx) {
+            out << (idx == 0 ? "" : ", ") << values[idx];
+        }
+        out << "]\n";
+    };
+    out << std::setprecision(std::numeric_limits<double>::digits10);
+    out << "L = " << base_config::L << "\n";
+    out << "m_stat_amount = " << base_config::m_stat_amount << "\n";
+    out << "j_stat_amount = " << base_config::j_stat_amount << "\n";
+    out << "mcs_init = " << base_config::mcs_init << "\n";
+    out << "mcs_observation = " << base_config::mcs_observation << "\n";
+    out << "N_size_vec = ";
+    list(base_config::N_size_vec);
+    out << "T_creation_vec = ";
+    list(base_config::T_creation_vec);
+    out << "T_sample_vec = ";
+    list(base_config::T_sample_vec);
+    out << "t_wait_vec = ";
+    list(base_config::t_wait_vec);
+    out << "magn_field_vec = [";
+    for (auto idx = 0u; idx < base_config::magn_field_vec.size(); ++idx) {
+        const auto& field = base_config::magn_field_vec[idx];
+        out << (idx == 0 ? "" : ", ") << "[" << field.x << ", " << field.y << ", " << field.z
+            << "]";
+    }
+    out << "]\n";
+}
+
+// записывает текущую развёртку в path, если файла ещё нет, иначе сверяет файл с ней. Файл
+// пишется во временный и появляется под своим именем через link, который не перезаписывает
+// существующий: процессы с общей папкой данных (--queue, --resume) не видят его недописанным,
+// а процесс с другой развёрткой не подменяет её остальным и завершается с ошибкой
+inline void storeSweep(const std::filesystem::path& path)
+{
+    std::ostringstream current{};
+    writeSweep(current);
+    if (!std::filesystem::exists(path)) {
+        char host[256]{};
+        gethostname(host, sizeof(host) - 1);
+        auto temp_path = path;
+        temp_path += ".tmp." + std::string{host} + "." + std::to_string(getpid());
+        {
+            std::ofstream out{temp_path};
+            out << current.str();
+            out.close();
+            if (!out) {
+                throw sweep_exception{"Can not write sweep file " + temp_path.string()};
+            }
+        }
+        std::error_code error{};
+        std::filesystem::create_hard_link(temp_path, path, error);
+        std::filesystem::remove(temp_path);
+        if (!error) {
+            return;
+        }
+        // иначе файл успел создать другой процесс
+        if (!std::filesystem::exists(path)) {
+            throw sweep_exception{
+                "Can not create sweep file " + path.string() + " : " + error.message()};
+        }
+    }
+    std::ifstream in{path};
+    std::ostringstream stored{};
+    stored << in.rdbuf();
+    if (stored.str() != current.str()) {
+        throw sweep_exception{
+            "Sweep file " + path.string()
+            + " differs from the sweep of this run, pass the same --sweep to every process"};
+    }
+}
+} // namespace task
+
+#endif
@@ -2,21 +2,98 @@
 #define SYSTEM_HPP_INCLUDED
 
 #include "config.hpp"
+#include "progress.hpp"
+#include "thread_pool.hpp"
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <queue>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <valarray>
 
 namespace task {
+// счётчики одной конкретизации sample_t: шаги Монте-Карло и время, проведённое в evolve,
+// шаги подготовок, посчитанных в этом запуске, отдельно с нуля (cold) и тёплым стартом от
+// решётки соседнего поля (warm), попытки обмена реплик при подготовке
+// и сумма времён автокорреляции |m1| при наблюдении по конфигурациям
+struct evolve_stats_t {
+    std::atomic<std::uint64_t> configs{0};
+    std::atomic<std::uint64_t> mcs{0};
+    std::atomic<std::uint64_t> nanoseconds{0};
+    std::atomic<std::uint64_t> prepared_cold{0};
+    std::atomic<std::uint64_t> prepare_mcs_cold{0};
+    std::atomic<std::uint64_t> prepared_warm{0};
+    std::atomic<std::uint64_t> prepare_mcs_warm{0};
+    std::atomic<std::uint64_t> swap_attempts{0};
+    std::atomic<std::uint64_t> swaps_accepted{0};
+    std::atomic<std::uint64_t> autocorrelation_configs{0};
+    std::atomic<double> autocorrelation_time{0.0};
+
+    double get_mcs_per_second() const noexcept
+    {
+        const auto time = static_cast<double>(nanoseconds.load()) * 1e-9;
+        return time > 0.0 ? static_cast<double>(mcs.load()) / time : 0.0;
+    }
+    // оба среднего - число сделанных шагов подготовки, включая разгон и окно усреднения
+    double get_prepare_mcs_cold() const noexcept
+    {
+        return average(prepare_mcs_cold.load(), prepared_cold.load());
+    }
+    double get_prepare_mcs_warm() const noexcept
+    {
+        return average(prepare_mcs_warm.load(), prepared_warm.load());
+    }
+    double get_swap_acceptance() const noexcept
+    {
+        const auto attempts = static_cast<double>(swap_attempts.load());
+        return attempts > 0.0 ? static_cast<double>(swaps_accepted.load()) / attempts : 0.0;
+    }
+    double get_autocorrelation_time() const noexcept
+    {
+        const auto configs_amount = static_cast<double>(autocorrelation_configs.load());
+        return configs_amount > 0.0 ? autocorrelation_time.load() / configs_amount : 0.0;
+    }
+    // время одного статистически независимого значения |m1|: 2 tau шагов по средней цене шага
+    double get_independent_seconds() const noexcept
+    {
+        const auto mcs_per_second = get_mcs_per_second();
+        return mcs_per_second > 0.0 ? 2.0 * get_autocorrelation_time() / mcs_per_second : 0.0;
+    }
+    void addAutocorrelationTime(double tau) noexcept
+    {
+        auto current = autocorrelation_time.load();
+        while (!autocorrelation_time.compare_exchange_weak(current, current + tau)) {
+        }
+        autocorrelation_configs++;
+    }
+
+private:
+    static double average(std::uint64_t sum, std::uint64_t amount) noexcept
+    {
+        return amount > 0 ? static_cast<double>(sum) / static_cast<double>(amount) : 0.0;
+    }
+};
+
+// Размеры образца - параметры шаблона: L и N известны при компиляции, поэтому размеры решёток,
+// площадь плёнки и границы циклов по слоям становятся константами. main выбирает конкретизацию
+// по таблице calculation_table (dispatch.hpp)
+template<std::uint16_t L, std::uint8_t N>
 struct sample_t {
+    static_assert(N >= 1 && N <= base_config::deltas.size());
+    constexpr static std::uint32_t area = std::uint32_t{L} * L;
+    inline static evolve_stats_t stats{};
+
     using lattice_t = qss::multilayer_system<qss::multilayer<typename base_config::lattice_t>>;
     using n_lattice_t = qss::multilayer<typename base_config::electron_dencity_t>;
 
     lattice_t lattice;
+    // реплики транспорта идут наборами по j_stat_amount, набор set - для t_wait_vec[set]
     std::vector<n_lattice_t> n_up_vec;
     std::vector<n_lattice_t> n_down_vec;
 
@@ -31,6 +108,15 @@ struct sample_t {
     const base_config::config_t config;
     const typename decltype(std::function{base_config::createHamilton_f})::result_type hamilt;
 
+    std::uint64_t mcs_done = 0;
+    std::chrono::steady_clock::duration evolve_time{};
+    // 0, если подготовка взята из кэша или у другой конфигурации
+    std::uint64_t prepare_mcs = 0;
+    bool is_warm_start = false;
+    std::uint64_t swap_attempts = 0;
+    std::uint64_t swaps_accepted = 0;
+    progress_t* progress = nullptr;
+
     sample_t(
         lattice_t&& lattice_,
         n_lattice_t&& n_up_,
@@ -38,13 +124,14 @@ struct sample_t {
         const base_config::config_t& config_)
         : lattice{lattice_}
         , config{config_}
-        , hamilt{base_config::createHamilton_f(config.field, base_config::getDelta(config.N))}
+        , hamilt{base_config::createHamilton_f(config.field, base_config::getDelta(N))}
     {
-        n_up_vec.reserve(task::base_config::j_stat_amount);
+        const auto replicas_amount = task::base_config::getReplicasAmount();
+        n_up_vec.reserve(replicas_amount);
         n_up_vec.push_back(std::move(n_up_));
-        n_down_vec.reserve(task::base_config::j_stat_amount);
+        n_down_vec.reserve(replicas_amount);
         n_down_vec.push_back(std::move(n_down_));
-        for (auto idx = 1u; idx < task::base_config::j_stat_amount; ++idx) {
+        for (auto idx = 1u; idx < replicas_amount; ++idx) {
             n_up_vec.push_back(n_up_vec[0]);
             n_down_vec.push_back(n_down_vec[0]);
         }
@@ -85,28 +172,58 @@ struct sample_t {
             }
         }
 
-        proxy_lattice_arr.reserve(task::base_config::j_stat_amount);
-        for (auto idx = 0u; idx < task::base_config::j_stat_amount; ++idx) {
+        proxy_lattice_arr.reserve(replicas_amount);
+        for (auto idx = 0u; idx < replicas_amount; ++idx) {
             proxy_lattice_arr.push_back(qss::algorithms::spin_transport::prepare_proxy_structure(
                 lattice, n_up_vec[idx], n_down_vec[idx], 'x'));
         }
     }
 
+    // один шаг Монте-Карло с учётом в счётчиках конкретизации
+    template<typename Hamiltonian>
+    void evolve(const Hamiltonian& hamiltonian)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        lattice.evolve(hamiltonian);
+        evolve_time += std::chrono::steady_clock::now() - start;
+        mcs_done++;
+        if (progress != nullptr) {
+            progress->addSweep();
+        }
+    }
+
+    // переносит счётчики образца в общие счётчики конкретизации
+    void commitStats() noexcept
+    {
+        stats.configs++;
+        stats.mcs += mcs_done;
+        stats.nanoseconds += static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(evolve_time).count());
+        if (prepare_mcs > 0 && is_warm_start) {
+            stats.prepared_warm++;
+            stats.prepare_mcs_warm += prepare_mcs;
+        } else if (prepare_mcs > 0) {
+            stats.prepared_cold++;
+            stats.prepare_mcs_cold += prepare_mcs;
+        }
+        stats.swap_attempts += swap_attempts;
+        stats.swaps_accepted += swaps_accepted;
+    }
+
     std::array<typename base_config::spin_t::magn_t, 2> makeMonteCarloStep()
     {
         lattice.T = config.T_sample;
-        lattice.evolve(hamilt);
+        evolve(hamilt);
         const auto magn1 = lattice.magns[0];
         const auto magn2 = lattice.magns[1];
 
         return {magn1, magn2};
     }
-    std::array<std::valarray<double>, 2> startObservation()
+    // Реплики транспорта независимы друг от друга, поэтому каждая считается отдельной
+    // подзадачей пула потоков. startObservation и makeJCalc работают с одним набором set
+    // и возвращают токи его j_stat_amount реплик
+    std::array<std::valarray<double>, 2> startObservation(std::size_t set = 0)
     {
-        std::for_each(
-            proxy_lattice_arr.begin(), proxy_lattice_arr.end(), [this](auto& proxy_lattice) {
-                proxy_lattice.T = config.T_sample;
-            });
         // const auto temp_magn1 = std::abs(lattice.magns[0].x * lattice.magns[0].x +
         // lattice.magns[0].y * lattice.magns[0].x); const auto temp_magn2 =
         // -std::abs(lattice.magns[1].x * lattice.magns[1].x + lattice.magns[1].y *
@@ -117,48 +234,44 @@ struct sample_t {
         const typename base_config::ed_t n_up_value{0.5 * (1.0 + temp_magn1)};
         const typename base_config::ed_t n_down_value{0.5 * (1.0 - temp_magn2)};
 
-        {
-            auto idx = 0u;
-            for (auto& n_up : n_up_vec) {
-                auto idx_film = 0u;
-                for (auto& film : n_up) {
-                    film.fill(n_up_value);
-                    const auto film_volume = static_cast<double>(film.get_amount_of_nodes());
-                    N_up_values_arr[idx_film][idx] = n_up_value / film_volume;
-                    idx_film++;
-                }
-                idx++;
-            }
-        }
-        {
-            auto idx = 0u;
-            for (auto& n_down : n_down_vec) {
-                auto idx_film = 0u;
-                for (auto& film : n_down) {
-                    film.fill(n_down_value);
-                    const auto film_volume = static_cast<double>(film.get_amount_of_nodes());
-                    N_down_values_arr[idx_film][idx] = n_down_value / film_volume;
-                    idx_film++;
-                }
-                idx++;
-            }
-        }
-
+        const auto first = set * task::base_config::j_stat_amount;
         std::valarray<double> j_up_arr(task::base_config::j_stat_amount);
         std::valarray<double> j_down_arr(task::base_config::j_stat_amount);
-        {
-            auto idx = 0u;
-            for (auto& proxy_lattice : proxy_lattice_arr) {
+        thread_pool_t::parallel_for(
+            task::base_config::j_stat_amount,
+            [this, first, &n_up_value, &n_down_value, &j_up_arr, &j_down_arr](
+                std::size_t replica) {
+                const auto idx = first + replica;
+                auto& proxy_lattice = proxy_lattice_arr[idx];
+                proxy_lattice.T = config.T_sample;
+                {
+                    auto idx_film = 0u;
+                    for (auto& film : n_up_vec[idx]) {
+                        film.fill(n_up_value);
+                        const auto film_volume = static_cast<double>(film.get_amount_of_nodes());
+                        N_up_values_arr[idx_film][idx] = n_up_value / film_volume;
+                        idx_film++;
+                    }
+                }
+                {
+                    auto idx_film = 0u;
+                    for (auto& film : n_down_vec[idx]) {
+                        film.fill(n_down_value);
+                        const auto film_volume = static_cast<double>(film.get_amount_of_nodes());
+                        N_down_values_arr[idx_film][idx] = n_down_value / film_volume;
+                        idx_film++;
+                    }
+                }
                 const auto [j_up, j_down] = qss::algorithms::spin_transport::perform(proxy_lattice);
-                j_up_arr[idx] = j_up;
-                j_down_arr[idx] = j_down;
-                idx++;
-            }
+                j_up_arr[replica] = j_up;
+                j_down_arr[replica] = j_down;
+            });
+        if (progress != nullptr) {
+            progress->addTransportCalls(task::base_config::j_stat_amount);
         }
-        constexpr auto area = base_config::L * base_config::L;
         return {j_up_arr / area, j_down_arr / area};
     }
-    std::array<std::valarray<double>, 2> makeJCalc()
+    std::array<std::valarray<double>, 2> makeJCalc(std::size_t set = 0)
     {
         // const auto temp_magn1 = std::abs(lattice.magns[0].x * lattice.magns[0].x +
         // lattice.magns[0].y * lattice.magns[0].y); const auto temp_magn2 =
@@ -170,34 +283,22 @@ struct sample_t {
         const typename base_config::ed_t n_up_value{0.5 * (1.0 + temp_magn1)};
         const typename base_config::ed_t n_down_value{0.5 * (1.0 - temp_magn2)};
 
-        {
-            auto idx = 0u;
-            for (auto& n_up : n_up_vec) {
-                n_up[0].fill_plane(0, n_up_value);
-                idx++;
-            }
-        }
-        {
-            auto idx = 0u;
-            for (auto& n_down : n_down_vec) {
-                n_down[0].fill_plane(0, n_down_value);
-                idx++;
-            }
-        }
+        const auto first = set * task::base_config::j_stat_amount;
         std::valarray<double> j_up_arr(task::base_config::j_stat_amount);
         std::valarray<double> j_down_arr(task::base_config::j_stat_amount);
-        {
-            auto idx = 0u;
-            for (auto& proxy_lattice : proxy_lattice_arr) {
+        thread_pool_t::parallel_for(
+            task::base_config::j_stat_amount,
+            [this, first, &n_up_value, &n_down_value, &j_up_arr, &j_down_arr](
+                std::size_t replica) {
+                const auto idx = first + replica;
+                n_up_vec[idx][0].fill_plane(0, n_up_value);
+                n_down_vec[idx][0].fill_plane(0, n_down_value);
+
+                auto& proxy_lattice = proxy_lattice_arr[idx];
                 const auto [j_up, j_down] = qss::algorithms::spin_transport::perform(proxy_lattice);
-                j_up_arr[idx] = j_up;
-                j_down_arr[idx] = j_down;
-                idx++;
-            }
-        }
-        {
-            auto idx = 0u;
-            for (auto& proxy_lattice : proxy_lattice_arr) {
+                j_up_arr[replica] = j_up;
+                j_down_arr[replica] = j_down;
+
                 for (auto& elem : N_up_values_arr) {
                     elem[idx] = 0.0;
                 }
@@ -213,18 +314,19 @@ struct sample_t {
                     }
                     film_id++;
                 }
-                idx++;
-            }
+            });
+        if (progress != nullptr) {
+            progress->addTransportCalls(task::base_config::j_stat_amount);
         }
-        constexpr auto area = base_config::L * base_config::L;
         return {j_up_arr / area, j_down_arr / area};
     }
 };
 
 // создаёт решётку при температуре T = 0
-inline sample_t createSample(const base_config::config_t& config) noexcept
+template<std::uint16_t L, std::uint8_t N>
+sample_t<L, N> createSample(const base_config::config_t& config) noexcept
 {
-    const typename base_config::sizes_t sizes{base_config::L, base_config::L, config.N};
+    const typename base_config::sizes_t sizes{L, L, N};
     const typename base_config::spin_t plus{1.0, 0.0, 0.0};
     const typename base_config::spin_t minus{-1.0, 0.0, 0.0};
 
@@ -237,34 +339,48 @@ inline sample_t createSample(const base_config::config_t& config) noexcept
     const typename base_config::ed_t n_0{0.0};
     const typename base_config::electron_dencity_t n_film{n_0, sizes};
 
-    return sample_t{
-        typename sample_t::lattice_t{qss::multilayer<typename base_config::lattice_t>{
+    using result_t = sample_t<L, N>;
+    return result_t{
+        typename result_t::lattice_t{qss::multilayer<typename base_config::lattice_t>{
             {fst_film, snd_film}, {base_config::J2}}},
-        typename sample_t::n_lattice_t{{n_film, n_film}, {base_config::J2}},
-        typename sample_t::n_lattice_t{{n_film, n_film}, {base_config::J2}},
+        typename result_t::n_lattice_t{{n_film, n_film}, {base_config::J2}},
+        typename result_t::n_lattice_t{{n_film, n_film}, {base_config::J2}},
         config};
 }
 
-// готовит образец до температуры T_creation ровно base_config::mcs_init шагов
-inline std::uint64_t prepare(sample_t& sam)
+// mcs - число сделанных шагов подготовки. init_stage_duration - счётчик строки
+// "Initialization stage duration" в info.txt, он считается как прежде: mcs_init плюс сумма
+// номеров шагов до совпадения средних, иначе info.txt разных версий нельзя сравнивать
+struct prepare_result_t {
+    std::uint64_t mcs = 0;
+    std::uint64_t init_stage_duration = 0;
+};
+
+// готовит образец до температуры T_creation: burn_in шагов разгона, mcs_init / 2 шагов окна
+// усреднения и дальше до совпадения средних, между шагами проверяет token и при отмене
+// бросает task_cancelled. Шаг - step(), он возвращает готовящуюся решётку и должен держать её
+// при T_creation
+template<typename Step>
+prepare_result_t prepare(const cancellation_token_t& token, std::uint64_t burn_in, Step&& step)
 {
-    const auto config = sam.config;
-    sam.lattice.T = config.T_creation;
-    const auto N = config.N;
-    const auto Delta = base_config::getDelta(N);
-    auto hamilt = base_config::createHamilton_f(config.field, Delta);
+    auto check_token = [&token](std::uint64_t mcs) {
+        if (token.is_cancelled()) {
+            throw task_cancelled{"phase : prepare, mcs : " + std::to_string(mcs)};
+        }
+    };
 
     base_config::spin_t::magn_t magn_fst_average{};
     base_config::spin_t::magn_t magn_snd_average{};
 
-    constexpr auto queue_size = base_config::mcs_init / 2;
+    const auto queue_size = base_config::mcs_init / 2;
     std::queue<std::array<base_config::spin_t::magn_t, 2u>> queue{};
-    for (auto _ = 0u; _ < base_config::mcs_init / 2; ++_) {
-        sam.lattice.evolve(hamilt);
+    for (auto mcs = 0u; mcs < burn_in; ++mcs) {
+        check_token(mcs);
+        step();
     }
-    for (auto _ = 0u; _ < base_config::mcs_init / 2; ++_) {
-        sam.lattice.evolve(hamilt);
-        const auto magns = sam.lattice.magns;
+    for (auto mcs = 0u; mcs < base_config::mcs_init / 2; ++mcs) {
+        check_token(burn_in + mcs);
+        const auto magns = step().magns;
         magn_fst_average += magns[0];
         magn_snd_average += magns[1];
         queue.push({magns[0], magns[1]});
@@ -274,11 +390,12 @@ inline std::uint64_t prepare(sample_t& sam)
     magn_snd_average /= size_as_double;
 
     constexpr auto eps = 1e-2; // 20.0 / (base_config::L * base_config::L * config.N);
-    auto mcs_to_init = base_config::mcs_init;
+    prepare_result_t result{burn_in + queue_size, base_config::mcs_init};
     for (auto mcs = 0u; mcs < 10'000; ++mcs) {
-        sam.lattice.evolve(hamilt);
-        const auto magn1 = sam.lattice.magns[0];
-        const auto magn2 = sam.lattice.magns[1];
+        check_token(result.mcs);
+        const auto& lattice = step();
+        const auto magn1 = lattice.magns[0];
+        const auto magn2 = lattice.magns[1];
 
         const auto elem_to_pop = queue.front();
         magn_fst_average -= elem_to_pop[0] / size_as_double;
@@ -290,14 +407,29 @@ inline std::uint64_t prepare(sample_t& sam)
         queue.pop();
         queue.push({magn1, magn2});
 
-        mcs_to_init += mcs;
+        result.mcs++;
+        result.init_stage_duration += mcs;
         if (is_almost_equals(magn_fst_average, magn1, eps)
             && is_almost_equals(magn_snd_average, magn2, eps)) {
             break;
         }
     };
 
-    return mcs_to_init;
+    return result;
+}
+
+// подготовка шагами Метрополиса с гамильтонианом образца
+template<typename Sample>
+prepare_result_t prepare(
+    Sample& sam,
+    const cancellation_token_t& token = {},
+    std::uint64_t burn_in = base_config::mcs_init / 2)
+{
+    sam.lattice.T = sam.config.T_creation;
+    return prepare(token, burn_in, [&sam]() -> const auto& {
+        sam.evolve(sam.hamilt);
+        return sam.lattice;
+    });
 }
 } // namespace task
 
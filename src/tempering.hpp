@@ -0,0 +1,181 @@
+#ifndef TEMPERING_HPP_INCLUDED
+#define TEMPERING_HPP_INCLUDED
+
+#include "config.hpp"
+#include "lattice_access.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace task {
+// replicas - число ступеней лестницы по полю, меньше двух - подготовка без обмена реплик.
+// Ступень k - поле h + k * step вдоль x, step = 0 - шаг по умолчанию. interval - шагов между
+// попытками обмена
+struct tempering_options_t {
+    unsigned replicas = 0;
+    double step = 0.0;
+    std::uint64_t interval = 10;
+
+    double getStep() const noexcept
+    {
+        return step > 0.0 ? step : 0.05;
+    }
+};
+
+// Обмен реплик при подготовке. Все ступени при T_creation, ступень 0 - поле образца. Шаг делают
+// все ступени сразу, каждая - подзадачей пула, и раз в interval шагов соседние ступени k, k + 1
+// (через раз чётные и нечётные пары) обмениваются решётками с вероятностью min(1, exp(-delta)),
+// delta = b (E_k(s_k+1) + E_k+1(s_k) - E_k(s_k) - E_k+1(s_k+1)), b = 1 / T_creation. Обмен
+// в delta сокращается, поэтому нужна только энергия поля (getFieldEnergy).
+// Меняются местами не решётки, а их ступени: на хранилище спинов образца ссылаются
+// прокси-решётки транспорта, поэтому оно не перемещается. finish() переносит в образец
+// решётку, которая оказалась на ступени 0.
+// Лестницы по температуре нет, только по полю вдоль x: обмен между температурами требует полной
+// энергии с обменным вкладом, а соседей узла qss наружу не отдаёт (см. lattice_access.hpp).
+// Выигрыш в шагах подготовки здесь не измеряется: его видно, сравнив столбцы prepare MCS таблицы
+// конкретизаций с запуском той же развёртки без --tempering. Генератор обменов засевается
+// stat_id, поэтому при тех же траекториях решёток решения об обмене повторяются
+template<typename Sample>
+class replica_exchange_t {
+public:
+    using lattice_t = typename Sample::lattice_t;
+
+    replica_exchange_t(Sample& sample, const tempering_options_t& options)
+        : m_sample{sample}
+        , m_beta{1.0 / sample.config.T_creation}
+        , m_interval{options.interval > 0 ? options.interval : 1}
+        , m_random{sample.config.stat_id}
+    {
+        const auto& config = sample.config;
+        const auto step = options.getStep();
+        sample.lattice.T = config.T_creation;
+        m_fields.reserve(options.replicas);
+        m_slots.reserve(options.replicas);
+        for (auto rung = 0u; rung < options.replicas; ++rung) {
+            const auto k = static_cast<double>(rung);
+            m_fields.push_back(config.field + base_config::magn_t{k * step, 0.0, 0.0});
+            m_slots.push_back(rung);
+        }
+        m_replicas.reserve(options.replicas - 1);
+        for (auto rung = 1u; rung < options.replicas; ++rung) {
+            m_replicas.push_back(sample.lattice);
+        }
+        m_attempts.assign(options.replicas - 1, 0);
+        m_accepted.assign(options.replicas - 1, 0);
+    }
+    replica_exchange_t(const replica_exchange_t&) = delete;
+    replica_exchange_t& operator=(const replica_exchange_t&) = delete;
+
+    // шаг Монте-Карло всех ступеней, возвращает решётку ступени 0. В счётчики образца идут
+    // шаги его собственной решётки, на какой бы ступени она ни стояла
+    const lattice_t& step()
+    {
+        thread_pool_t::parallel_for(m_slots.size(), [this](std::size_t rung) {
+            const auto slot = m_slots[rung];
+            if (slot == 0) {
+                m_sample.evolve(getHamiltonian(rung));
+                return;
+            }
+            m_replicas[slot - 1].evolve(getHamiltonian(rung));
+        });
+        if (++m_steps % m_interval == 0) {
+            trySwaps();
+        }
+        return getLattice(0);
+    }
+
+    // решётка ступени 0 поэлементно переносится в решётку образца
+    void finish()
+    {
+        if (m_slots[0] != 0) {
+            copyLatticeState(m_replicas[m_slots[0] - 1], m_sample.lattice);
+        }
+    }
+
+    std::uint64_t getAttempts() const noexcept
+    {
+        return sum(m_attempts);
+    }
+    std::uint64_t getAccepted() const noexcept
+    {
+        return sum(m_accepted);
+    }
+
+    // доли принятых обменов по парам ступеней через пробел
+    std::string getAcceptance() const
+    {
+        std::ostringstream out{};
+        for (auto pair = 0u; pair < m_attempts.size(); ++pair) {
+            const auto attempts = static_cast<double>(m_attempts[pair]);
+            out << (pair > 0 ? " " : "")
+                << (attempts > 0.0 ? static_cast<double>(m_accepted[pair]) / attempts : 0.0);
+        }
+        return out.str();
+    }
+
+private:
+    Sample& m_sample;
+    const double m_beta;
+    const std::uint64_t m_interval;
+    // гамильтониан хранит ссылку на поле, поэтому поля не перемещаются после создания
+    std::vector<base_config::magn_t> m_fields{};
+    // m_slots[k] - решётка на ступени k: 0 - решётка образца, i > 0 - m_replicas[i - 1]
+    std::vector<std::size_t> m_slots{};
+    std::vector<lattice_t> m_replicas{};
+    std::vector<std::uint64_t> m_attempts{};
+    std::vector<std::uint64_t> m_accepted{};
+    std::uint64_t m_steps = 0;
+    unsigned m_parity = 0;
+    std::mt19937_64 m_random;
+
+    static std::uint64_t sum(const std::vector<std::uint64_t>& values) noexcept
+    {
+        std::uint64_t result = 0;
+        for (const auto value : values) {
+            result += value;
+        }
+        return result;
+    }
+
+    auto getHamiltonian(std::size_t rung) const
+    {
+        return base_config::createHamilton_f(
+            m_fields[rung], base_config::getDelta(m_sample.config.N));
+    }
+
+    const lattice_t& getLattice(std::size_t rung) const
+    {
+        const auto slot = m_slots[rung];
+        return slot == 0 ? m_sample.lattice : m_replicas[slot - 1];
+    }
+
+    void trySwaps()
+    {
+        std::uniform_real_distribution<double> uniform{0.0, 1.0};
+        for (auto rung = std::size_t{m_parity}; rung + 1 < m_slots.size(); rung += 2) {
+            const auto& lower = getLattice(rung);
+            const auto& upper = getLattice(rung + 1);
+            const auto hamilt_lower = getHamiltonian(rung);
+            const auto hamilt_upper = getHamiltonian(rung + 1);
+            const auto delta = m_beta
+                * (getFieldEnergy(upper, hamilt_lower) - getFieldEnergy(lower, hamilt_lower)
+                   + getFieldEnergy(lower, hamilt_upper) - getFieldEnergy(upper, hamilt_upper));
+            m_attempts[rung]++;
+            if (delta <= 0.0 || uniform(m_random) < std::exp(-delta)) {
+                std::swap(m_slots[rung], m_slots[rung + 1]);
+                m_accepted[rung]++;
+            }
+        }
+        m_parity ^= 1u;
+    }
+};
+} // namespace task
+
+#endif
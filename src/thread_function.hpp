@@ -1,201 +1,413 @@
 #ifndef THREAD_FUNCTION_HPP_INCLUDED
 #define THREAD_FUNCTION_HPP_INCLUDED
 
+#include "autocorrelation.hpp"
+#include "checkpoint.hpp"
 #include "config.hpp"
+#include "config_dag.hpp"
 #include "output.hpp"
 #include "stat.hpp"
+#include "state_cache.hpp"
 #include "system.hpp"
+#include "tempering.hpp"
+#include "thread_pool.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <cmath>
+#include <filesystem>
+#include <map>
+#include <optional>
 #include <queue>
 #include <string>
+#include <utility>
 #include <valarray>
+#include <vector>
 
 namespace task {
-inline typename task::base_config::config_t
-calculation(typename task::base_config::config_t config, std::string_view current_dir)
+// interval - шагов наблюдения между контрольными точками, 0 - не сохранять их вовсе.
+// Кроме периодических, точка сохраняется после подготовки и после динамической стадии.
+// resume - продолжить с checkpoint_id=*.bin, если он остался от прерванного расчёта
+struct checkpoint_options_t {
+    std::uint64_t interval = 0;
+    bool resume = false;
+};
+
+// необязательные участники расчёта, nullptr - не используется.
+// В progress публикуются фаза и счётчики шагов для отчёта о ходе развёртки,
+// с state_cache подготовка берётся из кэша, а при промахе её результат туда сохраняется,
+// с config_dag образец копируется из подготовленного в другой конфигурации графа.
+// tempering - подготовка с обменом реплик, если в ней хотя бы две ступени
+struct calculation_options_t {
+    checkpoint_options_t checkpoint{};
+    tempering_options_t tempering{};
+    progress_t* progress = nullptr;
+    state_cache_t* state_cache = nullptr;
+    config_dag_t* config_dag = nullptr;
+};
+
+// выход на равновесие при T_sample, возвращает число сделанных шагов
+template<typename Sample, typename CheckToken>
+std::uint64_t runDynamicStage(
+    Sample& sample,
+    const outputer_t& outputer,
+    const base_config::config_t& config,
+    CheckToken&& check_token)
 {
+    base_config::spin_t::magn_t magn_fst_average{};
+    base_config::spin_t::magn_t magn_snd_average{};
+
+    auto m_dynamic_out
+        = outputer.createFile("m_dynamic_id=" + std::to_string(config.stat_id) + ".txt");
+    m_dynamic_out.printLn("m1", "m1x", "m1y", "m1z", "m2", "m2x", "m2y", "m2z");
+    auto theta_dynamic_out
+        = outputer.createFile("cos_theta_dynamic_id=" + std::to_string(config.stat_id) + ".txt");
+    theta_dynamic_out.printLn("cos_theta");
+    auto thetaXZ_dynamic_out
+        = outputer.createFile("cos_thetaXZ_dynamic_id=" + std::to_string(config.stat_id) + ".txt");
+    thetaXZ_dynamic_out.printLn("cos_thetaXZ");
+
+    constexpr auto queue_size = 500u;
+    std::queue<std::array<base_config::spin_t::magn_t, 2u>> queue{};
+    for (auto mcs = 0u; mcs < queue_size; ++mcs) {
+        check_token("dynamic", mcs);
+        const auto magns = sample.makeMonteCarloStep();
+        m_dynamic_out.printLn(abs(magns[0]), magns[0], abs(magns[1]), magns[1]);
+
+        const auto cos_theta = cos_of_angle(magns[0], magns[1]);
+        theta_dynamic_out.printLn(cos_theta);
+
+        const auto cos_thetaXZ = cos_of_angle(
+            task::base_config::magn_t{magns[0].x, 0.0, magns[0].z},
+            task::base_config::magn_t{magns[1].x, 0.0, magns[1].z});
+        thetaXZ_dynamic_out.printLn(cos_thetaXZ);
+
+        magn_fst_average += magns[0];
+        magn_snd_average += magns[1];
+        queue.push(std::move(magns));
+    }
+    const auto size_as_double = static_cast<double>(queue.size());
+    magn_fst_average /= size_as_double;
+    magn_snd_average /= size_as_double;
+
+    constexpr auto eps = 1e-2; // 20.0 / (base_config::L * base_config::L * config.N);
+
+    std::uint64_t mcs_on_dynamic_stage = queue_size;
+    for (auto mcs = 0u; mcs < 10'000; ++mcs) {
+        check_token("dynamic", mcs_on_dynamic_stage);
+        const auto [magn1, magn2] = sample.makeMonteCarloStep();
+        m_dynamic_out.printLn(abs(magn1), magn1, abs(magn2), magn2);
+
+        const auto elem_to_pop = queue.front();
+        magn_fst_average -= elem_to_pop[0] / size_as_double;
+        magn_snd_average -= elem_to_pop[1] / size_as_double;
+
+        magn_fst_average += magn1 / size_as_double;
+        magn_snd_average += magn2 / size_as_double;
+
+        queue.pop();
+        queue.push({magn1, magn2});
+
+        mcs_on_dynamic_stage++;
+        if (is_almost_equals(magn_fst_average, magn1, eps)
+            && is_almost_equals(magn_snd_average, magn2, eps)) {
+            break;
+        }
+    };
+    return mcs_on_dynamic_stage;
+}
+
+// token проверяется между шагами Монте-Карло, при отмене открытые файлы сбрасываются на диск,
+// место остановки записывается в stop_id=*.txt и бросается task_cancelled.
+// При восстановлении выходные файлы обрезаются до длин, записанных в контрольной точке,
+// поэтому строки, посчитанные после неё, не дублируются
+template<std::uint16_t L, std::uint8_t N>
+typename task::base_config::config_t calculation(
+    typename task::base_config::config_t config,
+    std::string_view current_dir,
+    const cancellation_token_t& token = {},
+    const calculation_options_t& options = {})
+{
+    const auto& checkpoint_options = options.checkpoint;
+    auto* const state_cache = options.state_cache;
     using task::base_config;
     outputer_t outputer{current_dir};
     outputer.EnterDirectory(task::createName(config));
+    const auto id = std::to_string(config.stat_id);
+    const auto checkpoint_path = outputer.getFolder() / ("checkpoint_id=" + id + ".bin");
 
-    auto m_out = outputer.createFile("m_id=" + std::to_string(config.stat_id) + ".txt");
-    m_out.printLn("m1", "m1x", "m1y", "m1z", "m2", "m2x", "m2y", "m2z");
-    auto theta_out = outputer.createFile("cos_theta_id=" + std::to_string(config.stat_id) + ".txt");
-    theta_out.printLn("cos_theta");
-    auto thetaXZ_out
-        = outputer.createFile("cos_thetaXZ_id=" + std::to_string(config.stat_id) + ".txt");
-    thetaXZ_out.printLn("cos_thetaXZ");
+    const auto start_timepoint = std::chrono::steady_clock::now();
+
+    // образец создаётся в потоке пула: если поток закреплён за ядром,
+    // память решёток при первом обращении выделяется на его NUMA-узле
+    auto sample = task::createSample<L, N>(config);
+    progress_t own_progress{};
+    auto& progress = options.progress != nullptr ? *options.progress : own_progress;
+    sample.progress = &progress;
+    checkpoint_t checkpoint{};
+    const bool is_resumed
+        = checkpoint_options.resume && std::filesystem::exists(checkpoint_path);
+    if (is_resumed) {
+        checkpoint = readCheckpoint(checkpoint_path, config, sample);
+    }
+    const auto resumed_phase = checkpoint.phase;
+    const auto resumed_mcs = checkpoint.mcs;
+    const std::map<std::string, std::uint64_t> offsets(
+        checkpoint.file_offsets.begin(), checkpoint.file_offsets.end());
+
+    std::vector<std::pair<std::string, outputer_t::output_file_t*>> files{};
+    auto open_file = [&outputer, &offsets](const std::string& name, auto... header) {
+        if (const auto iter = offsets.find(name); iter != offsets.end()) {
+            return outputer.reopenFile(name, iter->second);
+        }
+        auto file = outputer.createFile(name);
+        if constexpr (sizeof...(header) > 0) {
+            file.printLn(header...);
+        }
+        return file;
+    };
+
+    const auto m_name = "m_id=" + id + ".txt";
+    auto m_out = open_file(m_name, "m1", "m1x", "m1y", "m1z", "m2", "m2x", "m2y", "m2z");
+    const auto theta_name = "cos_theta_id=" + id + ".txt";
+    auto theta_out = open_file(theta_name, "cos_theta");
+    const auto thetaXZ_name = "cos_thetaXZ_id=" + id + ".txt";
+    auto thetaXZ_out = open_file(thetaXZ_name, "cos_thetaXZ");
+    files.emplace_back(m_name, &m_out);
+    files.emplace_back(theta_name, &theta_out);
+    files.emplace_back(thetaXZ_name, &thetaXZ_out);
 
     std::vector<typename outputer_t::output_file_t> j_out_vec{};
     std::vector<typename outputer_t::output_file_t> Nup_out_vec{};
     std::vector<typename outputer_t::output_file_t> Ndown_out_vec{};
-    for (auto idx = 0u; idx < task::base_config::j_stat_amount; ++idx) {
-        const std::string j_filename = "j_id="
-            + std::to_string(config.stat_id * task::base_config::j_stat_amount + idx) + ".txt";
-        auto j_out = outputer.createFile(j_filename);
-        j_out_vec.push_back(std::move(j_out));
-        j_out_vec[idx].printLn("j_up", "j_down");
-
-        const std::string Nup_filename = "Nup_id="
-            + std::to_string(config.stat_id * task::base_config::j_stat_amount + idx) + ".txt";
-        auto Nup_out = outputer.createFile(Nup_filename);
-        Nup_out_vec.push_back(std::move(Nup_out));
-        Nup_out_vec[idx].printLn("N_up_1", "N_up_2");
-
-        const std::string Ndown_filename = "Ndown_id="
-            + std::to_string(config.stat_id * task::base_config::j_stat_amount + idx) + ".txt";
-        auto Ndown_out = outputer.createFile(Ndown_filename);
-        Ndown_out_vec.push_back(std::move(Ndown_out));
-        Ndown_out_vec[idx].printLn("N_down_1", "N_down_2");
+    std::vector<std::string> j_names{};
+    std::vector<std::string> Nup_names{};
+    std::vector<std::string> Ndown_names{};
+    // файлы реплик идут в том же порядке, что и реплики образца: наборами по t_wait
+    for (const auto t_wait : base_config::t_wait_vec) {
+        for (auto idx = 0u; idx < task::base_config::j_stat_amount; ++idx) {
+            const auto j_id
+                = "_id=" + std::to_string(config.stat_id * task::base_config::j_stat_amount + idx)
+                + ".txt";
+            j_names.push_back(createTransportName("j", t_wait) + j_id);
+            j_out_vec.push_back(open_file(j_names.back(), "j_up", "j_down"));
+            Nup_names.push_back(createTransportName("Nup", t_wait) + j_id);
+            Nup_out_vec.push_back(open_file(Nup_names.back(), "N_up_1", "N_up_2"));
+            Ndown_names.push_back(createTransportName("Ndown", t_wait) + j_id);
+            Ndown_out_vec.push_back(open_file(Ndown_names.back(), "N_down_1", "N_down_2"));
+        }
+    }
+    for (auto idx = 0u; idx < j_out_vec.size(); ++idx) {
+        files.emplace_back(j_names[idx], &j_out_vec[idx]);
+        files.emplace_back(Nup_names[idx], &Nup_out_vec[idx]);
+        files.emplace_back(Ndown_names[idx], &Ndown_out_vec[idx]);
     }
 
-    const auto start_timepoint = std::chrono::steady_clock::now();
-
-    auto sample = task::createSample(config);
-    const auto init_mcs_amount = task::prepare(sample);
-    auto info_out
-        = outputer.createFile("info_id=" + std::to_string(config.stat_id) + ".txt");
-    info_out.printLn(
-        "Initialization stage duration : ", std::to_string(init_mcs_amount), "MCS/s");
+    // info_id=*.txt появляется только после подготовки, как и раньше
+    const auto info_name = "info_id=" + id + ".txt";
+    std::optional<outputer_t::output_file_t> info_out{};
+    auto open_info = [&]() {
+        info_out.emplace(open_file(info_name));
+        files.emplace_back(info_name, &*info_out);
+    };
+    if (resumed_phase != phase_t::prepare) {
+        open_info();
+    }
 
-    std::valarray<double> j_up_arr(task::base_config::j_stat_amount);
-    std::valarray<double> j_down_arr(task::base_config::j_stat_amount);
-    base_config::spin_t::magn_t magn_fst_average{};
-    base_config::spin_t::magn_t magn_snd_average{};
-    constexpr auto mcs_amount = base_config::mcs_observation + base_config::t_wait_vec.back();
-
-    {
-        auto m_dynamic_out
-            = outputer.createFile("m_dynamic_id=" + std::to_string(config.stat_id) + ".txt");
-        m_dynamic_out.printLn("m1", "m1x", "m1y", "m1z", "m2", "m2x", "m2y", "m2z");
-        auto theta_dynamic_out = outputer.createFile(
-            "cos_theta_dynamic_id=" + std::to_string(config.stat_id) + ".txt");
-        theta_dynamic_out.printLn("cos_theta");
-        auto thetaXZ_dynamic_out = outputer.createFile(
-            "cos_thetaXZ_dynamic_id=" + std::to_string(config.stat_id) + ".txt");
-        thetaXZ_dynamic_out.printLn("cos_thetaXZ");
-
-        constexpr auto queue_size = 500u;
-        std::queue<std::array<base_config::spin_t::magn_t, 2u>> queue{};
-        for (auto mcs = 0u; mcs < queue_size; ++mcs) {
-            const auto magns = sample.makeMonteCarloStep();
-            m_dynamic_out.printLn(abs(magns[0]), magns[0], abs(magns[1]), magns[1]);
-
-            const auto cos_theta = cos_of_angle(magns[0], magns[1]);
-            theta_dynamic_out.printLn(cos_theta);
-
-            const auto cos_thetaXZ = cos_of_angle(
-                task::base_config::magn_t{magns[0].x, 0.0, magns[0].z},
-                task::base_config::magn_t{magns[1].x, 0.0, magns[1].z});
-            thetaXZ_dynamic_out.printLn(cos_thetaXZ);
-
-            magn_fst_average += magns[0];
-            magn_snd_average += magns[1];
-            queue.push(std::move(magns));
-        }
-        const auto size_as_double = static_cast<double>(queue.size());
-        magn_fst_average /= size_as_double;
-        magn_snd_average /= size_as_double;
-
-        constexpr auto eps = 1e-2; // 20.0 / (base_config::L * base_config::L * config.N);
-
-        auto mcs_on_dynamic_stage = queue_size;
-        for (auto mcs = 0u; mcs < 10'000; ++mcs) {
-            const auto [magn1, magn2] = sample.makeMonteCarloStep();
-            m_dynamic_out.printLn(abs(magn1), magn1, abs(magn2), magn2);
-
-            const auto elem_to_pop = queue.front();
-            magn_fst_average -= elem_to_pop[0] / size_as_double;
-            magn_snd_average -= elem_to_pop[1] / size_as_double;
-
-            magn_fst_average += magn1 / size_as_double;
-            magn_snd_average += magn2 / size_as_double;
-
-            queue.pop();
-            queue.push({magn1, magn2});
-
-            mcs_on_dynamic_stage ++;
-            if (is_almost_equals(magn_fst_average, magn1, eps)
-                && is_almost_equals(magn_snd_average, magn2, eps)) {
-                break;
-            }
-        };
+    auto record_stop = [&](const std::string& where) {
+        for (auto& [name, file] : files) {
+            file->flush();
+        }
+        auto stop_out = outputer.createFile("stop_id=" + id + ".txt");
+        stop_out.printLn(where);
+    };
+    auto check_token = [&token, &record_stop](std::string_view phase, std::uint64_t mcs) {
+        if (token.is_cancelled()) {
+            const auto where
+                = "phase : " + std::string{phase} + ", mcs : " + std::to_string(mcs);
+            record_stop(where);
+            throw task_cancelled{where};
+        }
+    };
 
-        info_out.printLn(
-            "Dynamic stage duration : ", std::to_string(mcs_on_dynamic_stage), "MCS/s");
+    std::valarray<double> j_up_arr(task::base_config::getReplicasAmount());
+    std::valarray<double> j_down_arr(task::base_config::getReplicasAmount());
+    if (resumed_phase == phase_t::observation) {
+        j_up_arr = checkpoint.j_up_arr;
+        j_down_arr = checkpoint.j_down_arr;
     }
 
-    const auto first_timepoint = std::chrono::steady_clock::now();
-    const auto initialization_time = std::chrono::duration_cast<std::chrono::hours>(first_timepoint - start_timepoint);
-
-    for (auto mcs = 0u; mcs < mcs_amount; ++mcs) {
-        if (mcs == base_config::t_wait_vec.front()) {
-            const auto [up, down] = sample.startObservation();
-            j_up_arr += up;
-            j_down_arr += down;
-            for (auto idx = 0u; idx < j_out_vec.size(); ++idx) {
-                j_out_vec[idx].printLn(j_up_arr[idx], j_down_arr[idx]);
-            }
-            const auto& Nup_arr = sample.N_up_values_arr;
-            for (auto film_idx = 0u; film_idx < 2u; ++film_idx) {
-                for (auto idx = 0u; idx < Nup_out_vec.size(); ++idx) {
-                    const auto elem = Nup_arr[film_idx][idx];
-                    Nup_out_vec[idx].print(elem);
+    std::uint64_t checkpoints_amount = 0;
+    std::uintmax_t checkpoint_size = 0;
+    std::chrono::duration<double> checkpoints_time{};
+    auto save_checkpoint = [&](phase_t phase, std::uint64_t mcs) {
+        if (checkpoint_options.interval == 0) {
+            return;
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        checkpoint.phase = phase;
+        checkpoint.mcs = mcs;
+        checkpoint.j_up_arr = j_up_arr;
+        checkpoint.j_down_arr = j_down_arr;
+        checkpoint.file_offsets.clear();
+        for (auto& [name, file] : files) {
+            checkpoint.file_offsets.emplace_back(name, file->flush().position());
+        }
+        checkpoint_size = writeCheckpoint(checkpoint_path, config, checkpoint, sample);
+        checkpoints_amount++;
+        checkpoints_time += std::chrono::steady_clock::now() - begin;
+    };
+
+    if (resumed_phase == phase_t::prepare) {
+        state_cache_t::entry_t cached{};
+        const bool is_cached = state_cache != nullptr && state_cache->load(config, sample, cached);
+        std::optional<config_dag_t::start_t> start{};
+        if (!is_cached && options.config_dag != nullptr) {
+            start = options.config_dag->takeStart(config, sample.lattice);
+        }
+        // копия образца ведущей конфигурации уже подготовлена
+        const bool is_forked = start && start->kind == config_dag_t::start_t::kind_t::fork;
+        const bool is_tempered = options.tempering.replicas > 1;
+        std::string swap_acceptance{};
+        if (is_forked) {
+            cached.init_mcs = start->init_mcs;
+        } else if (!is_cached) {
+            const auto prepare_start = std::chrono::steady_clock::now();
+            prepare_result_t prepared{};
+            try {
+                // тёплому старту не нужен разгон, только окно усреднения
+                const auto burn_in = start ? 0 : base_config::mcs_init / 2;
+                if (is_tempered) {
+                    replica_exchange_t exchange{sample, options.tempering};
+                    prepared = task::prepare(
+                        token, burn_in, [&exchange]() -> const auto& { return exchange.step(); });
+                    exchange.finish();
+                    sample.swap_attempts = exchange.getAttempts();
+                    sample.swaps_accepted = exchange.getAccepted();
+                    swap_acceptance = exchange.getAcceptance();
+                } else {
+                    prepared = task::prepare(sample, token, burn_in);
                 }
+            } catch (const task_cancelled& exc) {
+                record_stop(exc.what());
+                throw;
             }
-            std::for_each(
-                Nup_out_vec.begin(), Nup_out_vec.end(), [](outputer_t::output_file_t& out) {
-                    out.printLn();
-                });
-            const auto& Ndown_arr = sample.N_down_values_arr;
-            for (auto film_idx = 0u; film_idx < 2u; ++film_idx) {
-                for (auto idx = 0u; idx < Ndown_out_vec.size(); ++idx) {
-                    const auto elem = Ndown_arr[film_idx][idx];
-                    Ndown_out_vec[idx].print(elem);
-                }
+            cached.init_mcs = prepared.init_stage_duration;
+            sample.prepare_mcs = prepared.mcs;
+            sample.is_warm_start = start.has_value();
+            cached.prepare_seconds = std::chrono::duration<double>(
+                                         std::chrono::steady_clock::now() - prepare_start)
+                                         .count();
+            if (state_cache != nullptr) {
+                state_cache->store(config, sample, cached);
             }
-            std::for_each(
-                Ndown_out_vec.begin(), Ndown_out_vec.end(), [](outputer_t::output_file_t& out) {
-                    out.printLn();
-                });
-        }
-        if (mcs > base_config::t_wait_vec.front()) {
-            const auto [up, down] = sample.makeJCalc();
-            j_up_arr += up;
-            j_down_arr += down;
-            for (auto idx = 0u; idx < j_out_vec.size(); ++idx) {
-                j_out_vec[idx].printLn(j_up_arr[idx], j_down_arr[idx]);
+        }
+        open_info();
+        info_out->printLn(
+            "Initialization stage duration : ", std::to_string(cached.init_mcs), "MCS/s");
+        if (sample.prepare_mcs > 0) {
+            info_out->printLn("Preparation MCS : ", std::to_string(sample.prepare_mcs));
+        }
+        if (state_cache != nullptr && !is_forked) {
+            info_out->printLn(
+                "Prepared state : ",
+                is_cached ? "loaded from" : "stored to",
+                state_cache->getPath(config).string());
+        }
+        if (is_tempered && !swap_acceptance.empty()) {
+            info_out->printLn(
+                "Replica exchange : ",
+                options.tempering.replicas,
+                "replicas, swap acceptance by pairs :",
+                swap_acceptance);
+        }
+        if (is_forked) {
+            info_out->printLn("Prepared state : forked from T_sample =", start->T_sample);
+        } else if (start) {
+            info_out->printLn("Warm start : from h =", to_string(start->field));
+        }
+        if (options.config_dag != nullptr) {
+            options.config_dag->publish(config, sample.lattice, cached.init_mcs);
+        }
+        save_checkpoint(phase_t::dynamic, 0);
+    }
+    if (resumed_phase != phase_t::observation) {
+        progress.enter(phase_t::dynamic);
+        const auto mcs_on_dynamic_stage
+            = runDynamicStage(sample, outputer, config, check_token);
+        info_out->printLn(
+            "Dynamic stage duration : ", std::to_string(mcs_on_dynamic_stage), "MCS/s");
+        save_checkpoint(phase_t::observation, 0);
+    }
+
+    const auto mcs_amount = base_config::mcs_observation + base_config::t_wait_vec.back();
+    const std::uint64_t first_mcs = resumed_phase == phase_t::observation ? resumed_mcs : 0;
+    const auto sets_amount = base_config::t_wait_vec.size();
+    const std::size_t set_size = base_config::j_stat_amount;
+    // прокси-решётки получают температуру в startObservation, который уже был до остановки
+    for (auto set = 0u; set < sets_amount; ++set) {
+        if (first_mcs > base_config::t_wait_vec[set]) {
+            for (auto idx = set * set_size; idx < (set + 1) * set_size; ++idx) {
+                sample.proxy_lattice_arr[idx].T = config.T_sample;
             }
+        }
+    }
 
-            const auto& Nup_arr = sample.N_up_values_arr;
-            for (auto film_idx = 0u; film_idx < sample.lattice.nanostructure.size(); ++film_idx) {
-                for (auto idx = 0u; idx < Nup_out_vec.size(); ++idx) {
-                    const auto elem = Nup_arr[film_idx][idx];
-                    Nup_out_vec[idx].print(elem);
+    // токи набора накапливаются, поэтому в j_tw=*_id=* пишется сумма по шагам наблюдения
+    auto print_transport = [&](std::size_t set, const std::array<std::valarray<double>, 2>& j) {
+        const auto first = set * set_size;
+        const std::slice replicas{first, set_size, 1};
+        j_up_arr[replicas] += j[0];
+        j_down_arr[replicas] += j[1];
+        for (auto idx = first; idx < first + set_size; ++idx) {
+            j_out_vec[idx].printLn(j_up_arr[idx], j_down_arr[idx]);
+        }
+        const auto print_films = [&](const auto& values_arr, auto& out_vec) {
+            for (auto film_idx = 0u; film_idx < values_arr.size(); ++film_idx) {
+                for (auto idx = first; idx < first + set_size; ++idx) {
+                    out_vec[idx].print(values_arr[film_idx][idx]);
                 }
             }
-            std::for_each(
-                Nup_out_vec.begin(), Nup_out_vec.end(), [](outputer_t::output_file_t& out) {
-                    out.printLn();
-                });
-
-            const auto& Ndown_arr = sample.N_down_values_arr;
-            for (auto film_idx = 0u; film_idx < sample.lattice.nanostructure.size(); ++film_idx) {
-                for (auto idx = 0u; idx < Ndown_out_vec.size(); ++idx) {
-                    const auto elem = Ndown_arr[film_idx][idx];
-                    Ndown_out_vec[idx].print(elem);
-                }
+            for (auto idx = first; idx < first + set_size; ++idx) {
+                out_vec[idx].printLn();
+            }
+        };
+        print_films(sample.N_up_values_arr, Nup_out_vec);
+        print_films(sample.N_down_values_arr, Ndown_out_vec);
+    };
+
+    // ряды |m| наблюдения для времени автокорреляции, после восстановления - с first_mcs
+    std::vector<double> m1_series{};
+    std::vector<double> m2_series{};
+    m1_series.reserve(mcs_amount - first_mcs);
+    m2_series.reserve(mcs_amount - first_mcs);
+
+    progress.enter(phase_t::observation, first_mcs);
+    const auto first_timepoint = std::chrono::steady_clock::now();
+    const auto initialization_time = std::chrono::duration_cast<std::chrono::hours>(first_timepoint - start_timepoint);
+
+    for (auto mcs = first_mcs; mcs < mcs_amount; ++mcs) {
+        if (checkpoint_options.interval > 0 && mcs != first_mcs
+            && mcs % checkpoint_options.interval == 0) {
+            save_checkpoint(phase_t::observation, mcs);
+        }
+        check_token("observation", mcs);
+        // набор set наблюдает mcs_observation шагов, начиная со своего t_wait
+        for (auto set = 0u; set < sets_amount; ++set) {
+            const auto t_wait = base_config::t_wait_vec[set];
+            if (mcs == t_wait) {
+                print_transport(set, sample.startObservation(set));
+            } else if (mcs > t_wait && mcs < t_wait + base_config::mcs_observation) {
+                print_transport(set, sample.makeJCalc(set));
             }
-            std::for_each(
-                Ndown_out_vec.begin(), Ndown_out_vec.end(), [](outputer_t::output_file_t& out) {
-                    out.printLn();
-                });
         }
 
         const auto [magn1, magn2] = sample.makeMonteCarloStep();
         m_out.printLn(abs(magn1), magn1, abs(magn2), magn2);
+        m1_series.push_back(abs(magn1));
+        m2_series.push_back(abs(magn2));
 
         const auto cos_theta = cos_of_angle(magn1, magn2);
         theta_out.printLn(cos_theta);
@@ -206,11 +418,47 @@ calculation(typename task::base_config::config_t config, std::string_view curren
         thetaXZ_out.printLn(cos_thetaXZ);
     }
 
+    if (checkpoint_options.interval > 0) {
+        info_out->printLn(
+            "Checkpoints : ",
+            checkpoints_amount,
+            "written in",
+            checkpoints_time.count(),
+            "s, last size",
+            checkpoint_size,
+            "bytes, every",
+            checkpoint_options.interval,
+            "MCS");
+    }
+    // независимые значения |m1| идут раз в 2 tau шагов, шаг стоит evolve_time / mcs_done
+    const auto m1_tau = stat::getAutocorrelationTime(m1_series);
+    const auto m2_tau = stat::getAutocorrelationTime(m2_series);
+    const auto seconds_per_mcs = sample.mcs_done > 0
+        ? std::chrono::duration<double>(sample.evolve_time).count()
+            / static_cast<double>(sample.mcs_done)
+        : 0.0;
+    info_out->printLn(
+        "Autocorrelation time of |m1|, |m2| : ",
+        m1_tau,
+        m2_tau,
+        "MCS over",
+        m1_series.size(),
+        "MCS, s per independent |m1|",
+        2.0 * m1_tau * seconds_per_mcs);
+    sample.stats.addAutocorrelationTime(m1_tau);
+    if (is_resumed) {
+        info_out->printLn(
+            "Resumed from checkpoint : ", to_string(resumed_phase), "mcs", resumed_mcs);
+    }
+    std::filesystem::remove(checkpoint_path);
+    sample.commitStats();
+    std::filesystem::remove(outputer.getFolder() / ("stop_id=" + id + ".txt"));
+
     const auto end_timepoint = std::chrono::steady_clock::now();
     const auto observation_time = std::chrono::duration_cast<std::chrono::hours>(first_timepoint - start_timepoint);
     const auto full_calculation_time = std::chrono::duration_cast<std::chrono::hours>(end_timepoint - start_timepoint);
 
-    auto timepoints_out = outputer.createFile("time_id=" + std::to_string(config.stat_id) + ".txt");
+    auto timepoints_out = outputer.createFile("time_id=" + id + ".txt");
     timepoints_out.printLn("initialization, h", "observation, h", "full, h");
     timepoints_out.printLn(initialization_time.count(), observation_time.count(), full_calculation_time.count());
 
@@ -219,4 +467,4 @@ calculation(typename task::base_config::config_t config, std::string_view curren
 
 } // namespace task
 
-#endif
\ No newline at end of file
+#endif
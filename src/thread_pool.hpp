@@ -1,154 +1,355 @@
 #ifndef THREAD_POOL_HPP_INCLUDED
 #define THREAD_POOL_HPP_INCLUDED
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <exception>
 #include <functional>
 #include <future>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+struct task_cancelled : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// кооперативная отмена: задача сама проверяет is_cancelled() между шагами.
+// Токен отменён, если вызван cancel(), истёк его срок или отменён родительский токен.
+// Пустой токен (по умолчанию) не отменяется никогда.
+class cancellation_token_t {
+    using clock_t = std::chrono::steady_clock;
+
+    struct state_t {
+        std::atomic<bool> cancelled{false};
+        std::optional<clock_t::time_point> deadline;
+        std::shared_ptr<const state_t> parent;
+    };
+    std::shared_ptr<state_t> m_state;
+
+public:
+    cancellation_token_t() = default;
+
+    static cancellation_token_t create(
+        const cancellation_token_t& parent = {},
+        std::optional<clock_t::time_point> deadline = std::nullopt)
+    {
+        cancellation_token_t token{};
+        token.m_state = std::make_shared<state_t>();
+        token.m_state->deadline = deadline;
+        token.m_state->parent = parent.m_state;
+        return token;
+    }
+
+    // атомарная запись без блокировок, можно вызывать из обработчика сигнала
+    void cancel() const noexcept
+    {
+        if (m_state) {
+            m_state->cancelled.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    bool is_cancelled() const noexcept
+    {
+        const state_t* state = m_state.get();
+        while (state != nullptr) {
+            if (state->cancelled.load(std::memory_order_relaxed)
+                || (state->deadline && clock_t::now() >= *state->deadline)) {
+                return true;
+            }
+            state = state->parent.get();
+        }
+        return false;
+    }
+
+    void throw_if_cancelled(const std::string& where) const
+    {
+        if (is_cancelled()) {
+            throw task_cancelled{where};
+        }
+    }
+};
+
+// выдаёт futures выполненных задач в порядке их завершения
+template<typename T>
+class completion_queue_t {
+public:
+    // оповещение под mutex: забравший последний результат может сразу уничтожить очередь,
+    // и notify_one после освобождения mutex обратился бы к уже разрушенной m_cv
+    void push(std::future<T>&& future)
+    {
+        std::lock_guard lg{mutex};
+        m_done.push_back(std::move(future));
+        m_cv.notify_one();
+    }
+
+    // блокирует, пока не завершится очередная задача
+    std::future<T> pop()
+    {
+        std::unique_lock lock{mutex};
+        m_cv.wait(lock, [this]() { return !m_done.empty(); });
+        auto result = std::move(m_done.front());
+        m_done.pop_front();
+        return result;
+    }
+
+    // пустой результат, если за timeout ни одна задача не завершилась
+    template<typename Rep, typename Period>
+    std::optional<std::future<T>> pop_for(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        std::unique_lock lock{mutex};
+        if (!m_cv.wait_for(lock, timeout, [this]() { return !m_done.empty(); })) {
+            return {};
+        }
+        auto result = std::move(m_done.front());
+        m_done.pop_front();
+        return result;
+    }
+
+    std::size_t size()
+    {
+        std::lock_guard lg{mutex};
+        return m_done.size();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable m_cv;
+    std::deque<std::future<T>> m_done;
+};
+
 class thread_pool_t {
 
     using task_t = std::packaged_task<void(void)>;
+    using clock_t = std::chrono::steady_clock;
 
 public:
     struct init_exception : public std::logic_error {
         using std::logic_error::logic_error;
     };
 
-    thread_pool_t(uint threads_amount = 2) noexcept
+    // shared_queue - одна общая очередь,
+    // work_stealing - у каждого потока своя очередь, свободные потоки воруют из чужих
+    enum class mode_t { shared_queue, work_stealing };
+
+    // cost - оценка трудоёмкости задачи, из общей очереди дорогие задачи берутся первыми,
+    // задачи с одинаковой оценкой - в порядке добавления.
+    // Задача, чей token отменён до её начала, не запускается, а её future получает task_cancelled.
+    // memory - оценка пиковой памяти задачи в байтах, учитывается при заданном бюджете памяти,
+    // label - имя задачи в журнале допуска.
+    struct task_info_t {
+        double cost = 0.0;
+        cancellation_token_t token{};
+        std::size_t memory = 0;
+        std::string label{};
+    };
+
+    // время простоя и работы одного потока
+    struct worker_stats_t {
+        std::thread::id id;
+        std::size_t idx = 0;
+        clock_t::duration idle{};
+        clock_t::duration busy{};
+        std::size_t tasks_done = 0;
+    };
+
+    thread_pool_t(uint threads_amount = 2, mode_t mode = mode_t::shared_queue) noexcept
+        : m_mode{mode}
+        , m_size{threads_amount}
     {
         assert(threads_amount > 0);
-        m_threads.reserve(threads_amount);
     }
 
     template<typename F, typename... Args>
     std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
     add_task(F&& f, Args&&... args)
     {
-        using Return = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+        return add_task(task_info_t{}, std::forward<F>(f), std::forward<Args>(args)...);
+    }
 
-        auto task_ptr = std::make_shared<std::packaged_task<Return()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    // в режиме work_stealing задачи, добавленные изнутри пула, идут в локальную очередь потока
+    // и оценка трудоёмкости для них не учитывается
+    template<typename F, typename... Args>
+    std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+    add_task(const task_info_t& info, F&& f, Args&&... args)
+    {
+        auto task_ptr = make_task(info.token, std::forward<F>(f), std::forward<Args>(args)...);
         task_t wrapped_task{[task_ptr]() { (*task_ptr)(); }};
+        auto result = task_ptr->get_future();
+
+        if (m_mode == mode_t::work_stealing && tl_pool == this) {
+            push_local(tl_worker, std::move(wrapped_task));
+            return result;
+        }
+        {
+            std::lock_guard lg{mutex};
+            enqueue({info.cost, info.memory, info.label, std::move(wrapped_task)});
+        }
+        m_cv.notify_one();
+        return result;
+    }
 
-        mutex.lock();
-        m_tasks.push_back(std::move(wrapped_task));
-        mutex.unlock();
-        return task_ptr->get_future();
+    // future задачи попадает в queue, когда задача выполнена (или выбросила исключение)
+    template<typename F, typename... Args>
+    void add_task(
+        completion_queue_t<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>& queue,
+        const task_info_t& info,
+        F&& f,
+        Args&&... args)
+    {
+        auto task_ptr = make_task(info.token, std::forward<F>(f), std::forward<Args>(args)...);
+        auto inner_info = info;
+        inner_info.token = {};
+        add_task(
+            inner_info, [task_ptr, future = task_ptr->get_future(), &queue]() mutable {
+                (*task_ptr)();
+                queue.push(std::move(future));
+            });
+    }
+
+    // выполняет f(idx) для всех idx из [0, amount). Внутри задачи пула итерации делятся на
+    // подзадачи, которые разбирают свободные потоки, а вызывающий поток, пока ждёт, сам выполняет
+    // подзадачи, поэтому пул не блокируется. Вне пула итерации выполняются последовательно.
+    // Первое исключение из f пробрасывается после завершения всех итераций.
+    template<typename F>
+    static void parallel_for(std::size_t amount, F&& f)
+    {
+        if (tl_pool == nullptr || amount < 2) {
+            for (auto idx = 0u; idx < amount; ++idx) {
+                f(idx);
+            }
+            return;
+        }
+        tl_pool->fork_join(amount, f);
     }
 
     std::size_t get_tasks_amount()
     {
         std::lock_guard lg{mutex};
-        return m_tasks.size();
+        return m_tasks.size() + m_pending;
     };
 
+    mode_t get_mode() const noexcept
+    {
+        return m_mode;
+    }
+
+    std::size_t get_threads_amount()
+    {
+        std::lock_guard lg{mutex};
+        return m_size;
+    };
+
+    // статистика по живым потокам, текущий интервал простоя или работы тоже учитывается
+    std::vector<worker_stats_t> get_workers_stats()
+    {
+        std::lock_guard lg{mutex};
+        std::shared_lock workers_lock{m_workers_mutex};
+        const auto now = clock_t::now();
+        std::vector<worker_stats_t> result{};
+        result.reserve(m_workers.size());
+        for (auto& worker : m_workers) {
+            std::lock_guard worker_lg{worker.mutex};
+            auto stats = worker.stats;
+            (worker.is_busy ? stats.busy : stats.idle) += now - worker.since;
+            result.push_back(std::move(stats));
+        }
+        return result;
+    }
+
+    // задачи из общей очереди запускаются, только пока сумма их оценок памяти не превышает budget
+    // байт, остальные ждут в очереди. Задача больше бюджета запускается, когда других нет.
+    // budget = 0 снимает ограничение. log вызывается под mutex пула и не должен обращаться к пулу.
+    void set_memory_budget(std::size_t budget, std::function<void(const std::string&)> log = {})
+    {
+        {
+            std::lock_guard lg{mutex};
+            m_memory_budget = budget;
+            m_admission_log = std::move(log);
+        }
+        m_cv.notify_all();
+    }
+
+    // вызывается в каждом новом потоке до первой задачи, аргумент - порядковый номер потока
+    void set_worker_init(std::function<void(std::size_t)> worker_init)
+    {
+        std::lock_guard lg{mutex};
+        if (m_inited) {
+            throw init_exception{"Method set_worker_init called after init"};
+        }
+        m_worker_init = std::move(worker_init);
+    }
+
     void init()
     {
         std::lock_guard lg{mutex};
         if (m_inited) {
             throw init_exception{"Method init called more than once"};
         };
-        for (auto idx = 0u; idx < m_threads.capacity(); ++idx) {
-            m_threads.emplace_back(&thread_pool_t::run, this);
+        for (auto idx = 0u; idx < m_size; ++idx) {
+            spawn_worker();
         }
         m_inited = true;
     };
 
+    // future готова, когда лишние потоки доделали свои задачи и остановились
     std::future<void> resize(std::size_t size)
     {
         if (size == 0) {
             throw std::underflow_error{"Method resize called with size = 0"};
         }
-        {
-            std::lock_guard lg{mutex};
-            if (size == m_threads.size()) {
-                std::promise<void> promise;
-                auto result = promise.get_future();
-                promise.set_value();
-                return result;
-            }
-        }
-        mutex.lock();
-        const auto current_size = m_threads.size();
-        mutex.unlock();
-        if (size > current_size) {
-            std::promise<void> promise;
-            auto result = promise.get_future();
-            std::lock_guard lg{mutex};
-            m_threads.reserve(size);
-            for (std::size_t idx = current_size; idx < size; ++idx) {
-                m_threads.emplace_back(&thread_pool_t::run, this);
+        std::unique_lock lock{mutex};
+        join_retired();
+
+        std::promise<void> promise;
+        auto result = promise.get_future();
+        if (!m_inited || size == m_size) {
+            m_size = size;
+            promise.set_value();
+            return result;
+        }
+        if (size > m_size) {
+            for (auto idx = m_size; idx < size; ++idx) {
+                spawn_worker();
             }
+            m_size = size;
             promise.set_value();
-
             return result;
         }
 
-        auto extra_threads = size - current_size;
-        auto destoy_task_ptr
-            = std::make_shared<std::packaged_task<void(void)>>([this, extra_threads]() {
-                  static std::vector<std::future<std::thread::id>> futures;
-                  futures.reserve(extra_threads);
-                  for (uint idx = 0; idx < extra_threads; ++idx) {
-                      auto task_ptr = std::make_shared<std::packaged_task<std::thread::id(void)>>(
-                          []() { return std::this_thread::get_id(); });
-                      task_t wrapped_task{[task_ptr]() { (*task_ptr)(); }};
-                      futures.emplace_back(task_ptr->get_future());
-                      std::lock_guard lg{mutex};
-                      m_tasks.push_front(std::move(wrapped_task));
-                  }
-
-                  while (!futures.empty()) {
-                      for (auto iter = futures.begin(); iter != futures.end(); ++iter) {
-                          auto& future = *iter;
-                          const auto status = future.wait_for(std::chrono::milliseconds(100));
-                          if (status != std::future_status::timeout) {
-                              const auto id = future.get();
-                              std::lock_guard lg{mutex};
-                              for (uint idx = 0; idx < m_threads.size(); ++idx) {
-                                  if ((m_threads[idx].get_id() == id) && m_threads[idx].joinable()) {
-                                      m_threads[idx].join();
-                                  }
-                              }
-                              futures.erase(iter);
-                              break;
-                          }
-                      }
-                  }
-
-                  std::lock_guard lg{mutex};
-                  for (uint _ = 0; _ < extra_threads; ++_) {
-                      for (auto iter = m_threads.begin(); iter != m_threads.end(); ++iter) {
-                          if (!iter->joinable()) {
-                              m_threads.erase(iter);
-                              break;
-                          }
-                      }
-                  }
-              });
-
-        task_t wrapped_task{[destoy_task_ptr]() { (*destoy_task_ptr)(); }};
-        auto result = destoy_task_ptr->get_future();
-        std::lock_guard lg{mutex};
-        m_tasks.push_front(std::move(wrapped_task));
+        const auto extra_threads = m_size - size;
+        m_stop_requests += extra_threads;
+        m_shrink_requests.push_back({extra_threads, std::move(promise)});
+        m_size = size;
+        lock.unlock();
+        m_cv.notify_all();
         return result;
     }
 
     ~thread_pool_t()
     {
-        mutex.lock();
-        m_termination = true;
-        mutex.unlock();
-        std::for_each(m_threads.begin(), m_threads.end(), [](std::thread& thread) {
-            if (thread.joinable()) {
-                thread.join();
+        {
+            std::lock_guard lg{mutex};
+            m_termination = true;
+        }
+        m_cv.notify_all();
+        for (auto& worker : m_workers) {
+            if (worker.thread.joinable()) {
+                worker.thread.join();
             }
-        });
+        }
+        join_retired();
     }
     thread_pool_t(const thread_pool_t&) = delete;
     thread_pool_t(thread_pool_t&&) = delete;
@@ -156,27 +357,386 @@ public:
     thread_pool_t& operator=(thread_pool_t&&) = delete;
 
 private:
-    void run()
+    // stats, since, is_busy и tasks защищены worker_t::mutex
+    struct worker_t {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+        worker_stats_t stats{};
+        clock_t::time_point since = clock_t::now();
+        bool is_busy = false;
+    };
+
+    struct queued_task_t {
+        double cost;
+        std::size_t memory;
+        std::string label;
+        task_t task;
+        bool is_deferral_logged = false;
+    };
+
+    template<typename F, typename... Args>
+    static auto make_task(const cancellation_token_t& token, F&& f, Args&&... args)
     {
-        mutex.lock();
-        while (!m_termination) {
-            if (!m_tasks.empty()) {
-                auto task = std::move(m_tasks.front());
-                m_tasks.pop_front();
-                mutex.unlock();
+        using Return = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+
+        return std::make_shared<std::packaged_task<Return()>>(
+            [token, bound = std::bind(std::forward<F>(f), std::forward<Args>(args)...)]() mutable {
+                token.throw_if_cancelled("task cancelled before start");
+                return bound();
+            });
+    }
+
+    struct fork_group_t {
+        std::atomic<std::size_t> left;
+        std::mutex error_mutex{};
+        std::exception_ptr error{};
 
-                task();
+        explicit fork_group_t(std::size_t amount)
+            : left{amount}
+        {
+        }
+    };
+
+    struct subtask_t {
+        std::function<void(void)> body;
+        fork_group_t* group;
+    };
+
+    struct shrink_request_t {
+        std::size_t threads_left;
+        std::promise<void> promise;
+    };
+
+    // вызывается под mutex, m_tasks отсортирована по убыванию cost
+    void enqueue(queued_task_t&& task)
+    {
+        if (m_tasks.empty() || m_tasks.back().cost >= task.cost) {
+            m_tasks.push_back(std::move(task));
+            return;
+        }
+        const auto iter = std::upper_bound(
+            m_tasks.begin(), m_tasks.end(), task.cost, [](double value, const queued_task_t& elem) {
+                return value > elem.cost;
+            });
+        m_tasks.insert(iter, std::move(task));
+    }
+
+    void log_admission(std::string_view action, const queued_task_t& task)
+    {
+        if (!m_admission_log) {
+            return;
+        }
+        constexpr auto MiB = 1024.0 * 1024.0;
+        std::ostringstream message{};
+        message << action << " " << task.label << " : " << static_cast<double>(task.memory) / MiB
+                << " MiB, in use " << static_cast<double>(m_memory_used) / MiB << " of "
+                << static_cast<double>(m_memory_budget) / MiB << " MiB";
+        m_admission_log(message.str());
+    }
+
+    // вызывается под mutex, первая по порядку задача, которая помещается в бюджет памяти
+    std::deque<queued_task_t>::iterator find_admissible()
+    {
+        if (m_memory_budget == 0 || m_memory_used == 0) {
+            return m_tasks.begin();
+        }
+        for (auto iter = m_tasks.begin(); iter != m_tasks.end(); ++iter) {
+            if (m_memory_used + iter->memory <= m_memory_budget) {
+                return iter;
+            }
+            if (!iter->is_deferral_logged) {
+                iter->is_deferral_logged = true;
+                log_admission("deferred", *iter);
             }
-            mutex.unlock();
         }
-        mutex.unlock();
+        return m_tasks.end();
     }
 
-    bool m_termination = false;
+    void release_memory(std::size_t memory)
+    {
+        if (memory == 0) {
+            return;
+        }
+        {
+            std::lock_guard lg{mutex};
+            m_memory_used -= memory;
+        }
+        m_cv.notify_all();
+    }
+
+    // вызывается под mutex
+    void spawn_worker()
+    {
+        std::lock_guard workers_lg{m_workers_mutex};
+        auto& worker = m_workers.emplace_back();
+        worker.stats.idx = m_spawned++;
+        worker.thread = std::thread{&thread_pool_t::run, this, &worker};
+        worker.stats.id = worker.thread.get_id();
+    }
+
+    // вызывается под mutex, поток сам себя убирает из m_workers
+    void retire(worker_t* worker)
+    {
+        m_stop_requests--;
+        auto& request = m_shrink_requests.front();
+        if (--request.threads_left == 0) {
+            request.promise.set_value();
+            m_shrink_requests.pop_front();
+        }
+        {
+            std::lock_guard worker_lg{worker->mutex};
+            m_pending -= worker->tasks.size();
+            for (auto& task : worker->tasks) {
+                enqueue({0.0, 0, {}, std::move(task)});
+            }
+            worker->tasks.clear();
+        }
+        if (!m_tasks.empty()) {
+            m_cv.notify_all();
+        }
+        std::lock_guard workers_lg{m_workers_mutex};
+        m_retired.push_back(std::move(worker->thread));
+        m_workers.remove_if([worker](const worker_t& elem) { return &elem == worker; });
+    }
+
+    void join_retired()
+    {
+        for (auto& thread : m_retired) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        m_retired.clear();
+    }
+
+    template<typename F>
+    void fork_join(std::size_t amount, F& f)
+    {
+        std::size_t chunks_amount = 0;
+        {
+            std::lock_guard lg{mutex};
+            chunks_amount = std::min(amount, 4 * m_size);
+        }
+        fork_group_t group{chunks_amount};
+        auto run_chunk = [&f, &group, amount, chunks_amount](std::size_t chunk) {
+            const auto first = chunk * amount / chunks_amount;
+            const auto last = (chunk + 1) * amount / chunks_amount;
+            try {
+                for (auto idx = first; idx < last; ++idx) {
+                    f(idx);
+                }
+            } catch (...) {
+                std::lock_guard lg{group.error_mutex};
+                if (!group.error) {
+                    group.error = std::current_exception();
+                }
+            }
+        };
+        {
+            std::lock_guard lg{mutex};
+            for (auto chunk = 1u; chunk < chunks_amount; ++chunk) {
+                m_subtasks.push_back({[&run_chunk, chunk]() { run_chunk(chunk); }, &group});
+            }
+        }
+        m_cv.notify_all();
+        m_join_cv.notify_all();
+
+        run_chunk(0);
+        finish_subtask(group);
+
+        std::unique_lock lock{mutex};
+        while (group.left > 0) {
+            if (!m_subtasks.empty()) {
+                auto subtask = std::move(m_subtasks.front());
+                m_subtasks.pop_front();
+                lock.unlock();
+                run_subtask(subtask);
+                lock.lock();
+                continue;
+            }
+            m_join_cv.wait(
+                lock, [this, &group]() { return group.left == 0 || !m_subtasks.empty(); });
+        }
+        lock.unlock();
+
+        if (group.error) {
+            std::rethrow_exception(group.error);
+        }
+    }
+
+    void run_subtask(subtask_t& subtask)
+    {
+        subtask.body();
+        finish_subtask(*subtask.group);
+    }
+
+    void finish_subtask(fork_group_t& group)
+    {
+        if (--group.left == 0) {
+            // ожидающий поток проверяет group.left под mutex, поэтому пробуждение не теряется
+            { std::lock_guard lg{mutex}; }
+            m_join_cv.notify_all();
+        }
+    }
+
+    void push_local(worker_t* worker, task_t&& task)
+    {
+        {
+            std::lock_guard lg{worker->mutex};
+            worker->tasks.push_back(std::move(task));
+            m_pending++;
+        }
+        if (m_sleeping > 0) {
+            // захват mutex гарантирует, что засыпающий поток либо увидит m_pending, либо уже ждёт
+            { std::lock_guard lg{mutex}; }
+            m_cv.notify_one();
+        }
+    }
+
+    // свою очередь поток разбирает с конца
+    std::optional<task_t> pop_local(worker_t* worker)
+    {
+        std::lock_guard lg{worker->mutex};
+        if (worker->tasks.empty()) {
+            return {};
+        }
+        auto task = std::move(worker->tasks.back());
+        worker->tasks.pop_back();
+        m_pending--;
+        return task;
+    }
+
+    // из чужих очередей воруем с начала
+    std::optional<task_t> steal(worker_t* thief)
+    {
+        std::shared_lock workers_lock{m_workers_mutex};
+        for (auto& victim : m_workers) {
+            if (&victim == thief) {
+                continue;
+            }
+            std::lock_guard victim_lg{victim.mutex};
+            if (victim.tasks.empty()) {
+                continue;
+            }
+            auto task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_pending--;
+            return task;
+        }
+        return {};
+    }
+
+    // пустой результат означает, что поток должен завершиться
+    std::optional<queued_task_t> next_task(worker_t* worker)
+    {
+        const bool is_stealing = m_mode == mode_t::work_stealing;
+        // при завершении пула локальные очереди бросаются так же, как общая
+        if (is_stealing && !m_termination) {
+            if (auto task = pop_local(worker)) {
+                return queued_task_t{0.0, 0, {}, std::move(*task)};
+            }
+        }
+
+        std::unique_lock lock{mutex};
+        while (true) {
+            if (m_termination) {
+                return {};
+            }
+            if (m_stop_requests > 0) {
+                retire(worker);
+                return {};
+            }
+            // подзадачи уже запущенных задач важнее новых задач
+            if (!m_subtasks.empty()) {
+                auto subtask = std::move(m_subtasks.front());
+                m_subtasks.pop_front();
+                task_t task{[this, subtask = std::move(subtask)]() mutable {
+                    run_subtask(subtask);
+                }};
+                return queued_task_t{0.0, 0, {}, std::move(task)};
+            }
+            if (const auto iter = find_admissible(); iter != m_tasks.end()) {
+                auto task = std::move(*iter);
+                m_tasks.erase(iter);
+                if (m_memory_budget > 0) {
+                    log_admission("admitted", task);
+                }
+                m_memory_used += task.memory;
+                return task;
+            }
+            if (is_stealing) {
+                lock.unlock();
+                if (auto task = steal(worker)) {
+                    return queued_task_t{0.0, 0, {}, std::move(*task)};
+                }
+                lock.lock();
+            }
+
+            m_sleeping++;
+            m_cv.wait(lock, [this]() {
+                return m_termination || m_stop_requests > 0 || !m_subtasks.empty()
+                    || find_admissible() != m_tasks.end() || m_pending > 0;
+            });
+            m_sleeping--;
+        }
+    }
+
+    void run(worker_t* worker)
+    {
+        tl_pool = this;
+        tl_worker = worker;
+        if (m_worker_init) {
+            m_worker_init(worker->stats.idx);
+        }
+        while (auto task = next_task(worker)) {
+            {
+                std::lock_guard lg{worker->mutex};
+                const auto now = clock_t::now();
+                worker->stats.idle += now - worker->since;
+                worker->since = now;
+                worker->is_busy = true;
+            }
+
+            task->task();
+            release_memory(task->memory);
+
+            std::lock_guard lg{worker->mutex};
+            const auto now = clock_t::now();
+            worker->stats.busy += now - worker->since;
+            worker->stats.tasks_done++;
+            worker->since = now;
+            worker->is_busy = false;
+        }
+    }
+
+    inline static thread_local thread_pool_t* tl_pool = nullptr;
+    inline static thread_local worker_t* tl_worker = nullptr;
+
+    const mode_t m_mode;
+    // пишется под mutex, читается и без него перед разбором локальной очереди
+    std::atomic<bool> m_termination = false;
     bool m_inited = false;
+    std::size_t m_size;
+    std::size_t m_stop_requests = 0;
+    std::size_t m_spawned = 0;
+    std::size_t m_memory_budget = 0;
+    std::size_t m_memory_used = 0;
+    std::function<void(const std::string&)> m_admission_log;
+    std::function<void(std::size_t)> m_worker_init;
+    std::atomic<std::size_t> m_pending = 0;
+    std::atomic<std::size_t> m_sleeping = 0;
     std::mutex mutex;
-    std::vector<std::thread> m_threads;
-    std::deque<task_t> m_tasks;
+    std::condition_variable m_cv;
+    // ожидающие в fork_join задачи не берут, поэтому ждут отдельно от свободных потоков:
+    // иначе notify_one о новой задаче мог бы достаться им и задача осталась бы в очереди
+    std::condition_variable m_join_cv;
+    std::shared_mutex m_workers_mutex;
+    std::list<worker_t> m_workers;
+    std::vector<std::thread> m_retired;
+    std::deque<shrink_request_t> m_shrink_requests;
+    std::deque<queued_task_t> m_tasks;
+    std::deque<subtask_t> m_subtasks;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,236 @@
+#ifndef WORK_QUEUE_HPP_INCLUDED
+#define WORK_QUEUE_HPP_INCLUDED
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <unistd.h>
+
+// Общая очередь работ в каталоге, доступном нескольким процессам (в том числе на разных узлах
+// с общей файловой системой). Работа с ключом key захватывается исключительным созданием leases/key,
+// выполненная отмечается файлом done/key. Фоновый поток продлевает захваченные аренды,
+// обновляя время изменения файла; аренда, не продлевавшаяся дольше lease_timeout, считается
+// брошенной и забирается другим процессом. Часы узлов должны расходиться много меньше
+// lease_timeout.
+class work_queue_t {
+public:
+    using clock_t = std::filesystem::file_time_type::clock;
+
+    enum class claim_t { claimed, done, busy };
+
+    struct work_queue_exception : public std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    work_queue_t(const std::filesystem::path& dir, std::chrono::seconds lease_timeout)
+        : m_leases{dir / "leases"}
+        , m_done{dir / "done"}
+        , m_timeout{lease_timeout}
+        , m_owner{make_owner()}
+    {
+        std::filesystem::create_directories(m_leases);
+        std::filesystem::create_directories(m_done);
+        m_renewer = std::thread{[this]() { renew_loop(); }};
+    }
+    work_queue_t(const work_queue_t&) = delete;
+    work_queue_t& operator=(const work_queue_t&) = delete;
+
+    ~work_queue_t()
+    {
+        {
+            std::lock_guard lg{m_mutex};
+            m_is_terminated = true;
+        }
+        m_cv.notify_all();
+        m_renewer.join();
+    }
+
+    const std::string& get_owner() const noexcept
+    {
+        return m_owner;
+    }
+
+    bool is_done(const std::string& key) const
+    {
+        return std::filesystem::exists(m_done / key);
+    }
+
+    // token отменяется, если аренду забрал другой процесс
+    claim_t try_claim(const std::string& key, const cancellation_token_t& token)
+    {
+        if (is_done(key)) {
+            return claim_t::done;
+        }
+        if (!create_lease(key) && !(reclaim_stale(key) && create_lease(key))) {
+            return claim_t::busy;
+        }
+        // работа могла завершиться между проверкой и захватом
+        if (is_done(key)) {
+            release(key);
+            return claim_t::done;
+        }
+        std::lock_guard lg{m_mutex};
+        m_held.insert_or_assign(key, token);
+        m_lost.erase(key);
+        return claim_t::claimed;
+    }
+
+    // аренду key, пока работа шла, забрал другой процесс: отмена её token - не отмена расчёта
+    bool is_lost(const std::string& key)
+    {
+        std::lock_guard lg{m_mutex};
+        return m_lost.count(key) > 0;
+    }
+
+    void complete(const std::string& key)
+    {
+        std::ofstream{m_done / key} << m_owner << "\n";
+        release(key);
+    }
+
+    // снимает аренду, только если она ещё принадлежит этому процессу
+    void release(const std::string& key)
+    {
+        {
+            std::lock_guard lg{m_mutex};
+            m_held.erase(key);
+        }
+        if (is_owned(key)) {
+            std::error_code error{};
+            std::filesystem::remove(m_leases / key, error);
+        }
+    }
+
+private:
+    std::filesystem::path m_leases;
+    std::filesystem::path m_done;
+    std::chrono::seconds m_timeout;
+    std::string m_owner;
+
+    std::map<std::string, cancellation_token_t> m_held{};
+    std::set<std::string> m_lost{};
+    std::mutex m_mutex{};
+    std::condition_variable m_cv{};
+    bool m_is_terminated = false;
+    std::thread m_renewer{};
+
+    static std::string make_owner()
+    {
+        static std::atomic<unsigned> counter{0};
+        char host[256]{};
+        gethostname(host, sizeof(host) - 1);
+        return std::string{host} + ":" + std::to_string(getpid()) + ":"
+            + std::to_string(counter++);
+    }
+
+    // режим "x" открывает файл с O_EXCL: из нескольких процессов создать аренду удаётся одному
+    bool create_lease(const std::string& key)
+    {
+        const auto path = m_leases / key;
+        std::FILE* file = std::fopen(path.c_str(), "wx");
+        if (file == nullptr) {
+            if (errno == EEXIST) {
+                return false;
+            }
+            throw work_queue_exception{
+                "Can not create lease " + path.string() + " : "
+                + std::system_category().message(errno)};
+        }
+        const auto content = m_owner + "\n";
+        const auto written = std::fwrite(content.data(), 1, content.size(), file);
+        if (std::fclose(file) != 0 || written != content.size()) {
+            throw work_queue_exception{"Can not write lease " + path.string()};
+        }
+        return true;
+    }
+
+    // владелец аренды или пустой результат, если это сейчас неизвестно: файла нет (его может
+    // временно переименовать reclaim_stale другого процесса) или его только создают
+    std::optional<std::string> read_owner(const std::string& key) const
+    {
+        std::ifstream in{m_leases / key};
+        std::string owner{};
+        if (!std::getline(in, owner) || owner.empty()) {
+            return std::nullopt;
+        }
+        return owner;
+    }
+
+    bool is_owned(const std::string& key) const
+    {
+        return read_owner(key) == m_owner;
+    }
+
+    bool is_stale(const std::filesystem::path& path) const
+    {
+        std::error_code error{};
+        const auto last_renewal = std::filesystem::last_write_time(path, error);
+        return !error && clock_t::now() - last_renewal >= m_timeout;
+    }
+
+    // брошенная аренда переименовывается: rename атомарен, поэтому забрать её может только
+    // один процесс, остальные получат ошибку. Если между проверкой и переименованием аренду
+    // успели захватить заново, она возвращается на место через link, который не перезаписывает
+    // чужую аренду
+    bool reclaim_stale(const std::string& key)
+    {
+        const auto path = m_leases / key;
+        if (!is_stale(path)) {
+            return false;
+        }
+        auto stale_path = path;
+        stale_path += ".stale." + m_owner;
+        std::error_code error{};
+        std::filesystem::rename(path, stale_path, error);
+        if (error) {
+            return false;
+        }
+        const bool is_still_stale = is_stale(stale_path);
+        if (!is_still_stale) {
+            ::link(stale_path.c_str(), path.c_str());
+        }
+        std::filesystem::remove(stale_path, error);
+        return is_still_stale;
+    }
+
+    void renew_loop()
+    {
+        const auto period = std::max(std::chrono::seconds{1}, m_timeout / 4);
+        std::unique_lock ul{m_mutex};
+        while (!m_cv.wait_for(ul, period, [this]() { return m_is_terminated; })) {
+            for (const auto& [key, token] : m_held) {
+                // аренда отнята, только если файл есть и в нём другой владелец,
+                // иначе проверка повторяется через period
+                const auto owner = read_owner(key);
+                if (!owner) {
+                    continue;
+                }
+                if (*owner != m_owner) {
+                    m_lost.insert(key);
+                    token.cancel();
+                    continue;
+                }
+                std::error_code error{};
+                std::filesystem::last_write_time(m_leases / key, clock_t::now(), error);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "affinity.hpp"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// два узла по два ядра, у каждого ядра SMT-сосед: {id, core, package, node}
+const std::vector<affinity::cpu_t> two_nodes{
+    {0, 0, 0, 0},
+    {1, 1, 0, 0},
+    {2, 0, 1, 1},
+    {3, 1, 1, 1},
+    {4, 0, 0, 0},
+    {5, 1, 0, 0},
+    {6, 0, 1, 1},
+    {7, 1, 1, 1}};
+} // namespace
+
+TEST(affinity, parses_cpu_lists)
+{
+    EXPECT_EQ(
+        affinity::parse_cpu_list("0-3,8,10-11\n"), (std::vector<uint>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(affinity::parse_cpu_list("5"), (std::vector<uint>{5}));
+    EXPECT_TRUE(affinity::parse_cpu_list("").empty());
+    EXPECT_TRUE(affinity::parse_cpu_list("\n").empty());
+}
+
+TEST(affinity, parses_policies)
+{
+    EXPECT_EQ(affinity::parse_policy("none"), affinity::policy_t::none);
+    EXPECT_EQ(affinity::parse_policy("compact"), affinity::policy_t::compact);
+    EXPECT_EQ(affinity::parse_policy("scatter"), affinity::policy_t::scatter);
+    EXPECT_THROW(affinity::parse_policy("spread"), std::invalid_argument);
+}
+
+TEST(affinity, compact_fills_node_by_node_before_smt_siblings)
+{
+    EXPECT_EQ(
+        affinity::make_pinning_order(two_nodes, affinity::policy_t::compact),
+        (std::vector<uint>{0, 1, 2, 3, 4, 5, 6, 7}));
+}
+
+TEST(affinity, scatter_alternates_nodes_before_smt_siblings)
+{
+    EXPECT_EQ(
+        affinity::make_pinning_order(two_nodes, affinity::policy_t::scatter),
+        (std::vector<uint>{0, 2, 1, 3, 4, 6, 5, 7}));
+}
+
+TEST(affinity, none_and_empty_topology_do_not_pin)
+{
+    EXPECT_TRUE(affinity::make_pinning_order(two_nodes, affinity::policy_t::none).empty());
+    EXPECT_TRUE(affinity::make_pinning_order({}, affinity::policy_t::compact).empty());
+}
+
+TEST(affinity, finds_node_of_cpu)
+{
+    EXPECT_EQ(affinity::node_of(two_nodes, 6), 1);
+    EXPECT_EQ(affinity::node_of(two_nodes, 5), 0);
+    EXPECT_EQ(affinity::node_of(two_nodes, 42), -1);
+}
@@ -0,0 +1,104 @@
+#include "config.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace {
+using config_t = task::base_config::config_t;
+using config_key_t
+    = std::tuple<std::uint16_t, std::uint8_t, double, double, double, double, double>;
+
+config_key_t getKey(const config_t& config)
+{
+    return {
+        config.stat_id,
+        config.N,
+        config.T_creation,
+        config.T_sample,
+        config.field.x,
+        config.field.y,
+        config.field.z};
+}
+
+std::vector<config_key_t> getKeys(const std::vector<config_t>& configs)
+{
+    std::vector<config_key_t> keys{};
+    for (const auto& config : configs) {
+        keys.push_back(getKey(config));
+    }
+    return keys;
+}
+
+double getLoad(const std::vector<config_t>& configs)
+{
+    double load = 0.0;
+    for (const auto& config : configs) {
+        load += task::estimateCost(config);
+    }
+    return load;
+}
+} // namespace
+
+TEST(select_shard, shards_cover_every_config_once)
+{
+    const auto configs = task::base_config::getConfigs();
+    constexpr std::size_t shards_amount = 7;
+    std::map<config_key_t, unsigned> seen{};
+    for (auto shard = 0u; shard < shards_amount; ++shard) {
+        for (const auto& key : getKeys(task::selectShard(configs, shard, shards_amount))) {
+            seen[key]++;
+        }
+    }
+    ASSERT_EQ(seen.size(), configs.size());
+    for (const auto& [key, count] : seen) {
+        EXPECT_EQ(count, 1u);
+    }
+}
+
+TEST(select_shard, keeps_order_and_is_deterministic)
+{
+    const auto configs = task::base_config::getConfigs();
+    const auto all_keys = getKeys(configs);
+    for (auto shard = 0u; shard < 3; ++shard) {
+        const auto keys = getKeys(task::selectShard(configs, shard, 3));
+        EXPECT_EQ(keys, getKeys(task::selectShard(configs, shard, 3)));
+        // конфигурации доли идут в порядке исходного списка
+        std::vector<std::size_t> positions{};
+        for (const auto& key : keys) {
+            positions.push_back(static_cast<std::size_t>(
+                std::find(all_keys.begin(), all_keys.end(), key) - all_keys.begin()));
+        }
+        EXPECT_TRUE(std::is_sorted(positions.begin(), positions.end()));
+    }
+}
+
+TEST(select_shard, balances_estimated_cost)
+{
+    // трудоёмкость растёт с N, поэтому конфигурации неравноценны
+    const auto configs = task::base_config::getConfigs();
+    double max_cost = 0.0;
+    for (const auto& config : configs) {
+        max_cost = std::max(max_cost, task::estimateCost(config));
+    }
+    for (const std::size_t shards_amount : {2u, 4u, 7u}) {
+        std::vector<double> loads{};
+        for (auto shard = 0u; shard < shards_amount; ++shard) {
+            loads.push_back(getLoad(task::selectShard(configs, shard, shards_amount)));
+        }
+        const auto [min_load, max_load] = std::minmax_element(loads.begin(), loads.end());
+        // жадное распределение: разброс долей не больше самой дорогой конфигурации
+        EXPECT_LE(*max_load - *min_load, max_cost);
+    }
+}
+
+TEST(select_shard, single_shard_is_the_whole_list)
+{
+    const auto configs = task::base_config::getConfigs();
+    EXPECT_EQ(getKeys(task::selectShard(configs, 0, 1)), getKeys(configs));
+}
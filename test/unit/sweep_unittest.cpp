@@ -0,0 +1,188 @@
+#include "sweep.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+// loadSweep меняет статические поля base_config, поэтому каждый тест возвращает их обратно
+class sweep_test : public ::testing::Test {
+protected:
+    using base_config = task::base_config;
+
+    void SetUp() override
+    {
+        L = base_config::L;
+        m_stat_amount = base_config::m_stat_amount;
+        j_stat_amount = base_config::j_stat_amount;
+        mcs_init = base_config::mcs_init;
+        mcs_observation = base_config::mcs_observation;
+        N_size_vec = base_config::N_size_vec;
+        T_creation_vec = base_config::T_creation_vec;
+        T_sample_vec = base_config::T_sample_vec;
+        t_wait_vec = base_config::t_wait_vec;
+        magn_field_vec = base_config::magn_field_vec;
+        path = std::filesystem::temp_directory_path()
+            / ("gmr_sweep_" + std::to_string(getpid()) + ".toml");
+    }
+
+    void TearDown() override
+    {
+        base_config::L = L;
+        base_config::m_stat_amount = m_stat_amount;
+        base_config::j_stat_amount = j_stat_amount;
+        base_config::mcs_init = mcs_init;
+        base_config::mcs_observation = mcs_observation;
+        base_config::N_size_vec = N_size_vec;
+        base_config::T_creation_vec = T_creation_vec;
+        base_config::T_sample_vec = T_sample_vec;
+        base_config::t_wait_vec = t_wait_vec;
+        base_config::magn_field_vec = magn_field_vec;
+        std::filesystem::remove(path);
+    }
+
+    void load(const std::string& text)
+    {
+        {
+            std::ofstream out{path};
+            out << text;
+        }
+        task::loadSweep(path);
+    }
+
+    std::filesystem::path path{};
+
+private:
+    std::uint16_t L = 0;
+    std::uint16_t m_stat_amount = 0;
+    std::uint16_t j_stat_amount = 0;
+    std::uint64_t mcs_init = 0;
+    std::uint64_t mcs_observation = 0;
+    std::vector<unsigned> N_size_vec{};
+    std::vector<double> T_creation_vec{};
+    std::vector<double> T_sample_vec{};
+    std::vector<unsigned> t_wait_vec{};
+    std::vector<base_config::magn_t> magn_field_vec{};
+};
+} // namespace
+
+TEST_F(sweep_test, reads_numbers_arrays_and_comments)
+{
+    load("# развёртка\n"
+         "L = 32\n"
+         "m_stat_amount = 3 # прогонки\n"
+         "j_stat_amount = 4\n"
+         "mcs_init = 100\n"
+         "mcs_observation = 200\n"
+         "N_size_vec = [1,\n"
+         "  2, 10]\n"
+         "T_creation_vec = [0.5]\n"
+         "T_sample_vec = [0.95, 1.5e0]\n"
+         "t_wait_vec = [0, 100]\n"
+         "magn_field_vec = [0.0, 0.5, [1.0, 0.25, -1.0]]\n");
+
+    EXPECT_EQ(base_config::L, 32);
+    EXPECT_EQ(base_config::m_stat_amount, 3);
+    EXPECT_EQ(base_config::j_stat_amount, 4);
+    EXPECT_EQ(base_config::mcs_init, 100u);
+    EXPECT_EQ(base_config::mcs_observation, 200u);
+    EXPECT_EQ(base_config::N_size_vec, (std::vector<unsigned>{1, 2, 10}));
+    EXPECT_EQ(base_config::T_creation_vec, (std::vector<double>{0.5}));
+    EXPECT_EQ(base_config::T_sample_vec, (std::vector<double>{0.95, 1.5}));
+    EXPECT_EQ(base_config::t_wait_vec, (std::vector<unsigned>{0, 100}));
+    ASSERT_EQ(base_config::magn_field_vec.size(), 3u);
+    EXPECT_EQ(base_config::magn_field_vec[1].x, 0.5);
+    EXPECT_EQ(base_config::magn_field_vec[1].y, 0.0);
+    EXPECT_EQ(base_config::magn_field_vec[2].x, 1.0);
+    EXPECT_EQ(base_config::magn_field_vec[2].y, 0.25);
+    EXPECT_EQ(base_config::magn_field_vec[2].z, -1.0);
+}
+
+TEST_F(sweep_test, keeps_defaults_of_missing_keys)
+{
+    const auto N_size_vec = base_config::N_size_vec;
+    const auto mcs_observation = base_config::mcs_observation;
+    load("mcs_init = 10\n");
+    EXPECT_EQ(base_config::mcs_init, 10u);
+    EXPECT_EQ(base_config::N_size_vec, N_size_vec);
+    EXPECT_EQ(base_config::mcs_observation, mcs_observation);
+}
+
+TEST_F(sweep_test, rejects_malformed_files)
+{
+    EXPECT_THROW(load("unknown = 1\n"), task::sweep_exception);
+    EXPECT_THROW(load("L\n"), task::sweep_exception);
+    EXPECT_THROW(load("L = abc\n"), task::sweep_exception);
+    EXPECT_THROW(load("L = 64 64\n"), task::sweep_exception);
+    EXPECT_THROW(load("N_size_vec = [3 5]\n"), task::sweep_exception);
+    EXPECT_THROW(load("N_size_vec = [3, 5\n"), task::sweep_exception);
+    EXPECT_THROW(load("N_size_vec = []\n"), task::sweep_exception);
+    EXPECT_THROW(load("N_size_vec = 3\n"), task::sweep_exception);
+    EXPECT_THROW(load("m_stat_amount = 2.5\n"), task::sweep_exception);
+    EXPECT_THROW(load("m_stat_amount = -1\n"), task::sweep_exception);
+    EXPECT_THROW(load("magn_field_vec = [[1.0, 0.0]]\n"), task::sweep_exception);
+    EXPECT_THROW(load("T_sample_vec = [[0.9]]\n"), task::sweep_exception);
+}
+
+TEST_F(sweep_test, validates_values)
+{
+    EXPECT_THROW(load("L = 48\n"), task::sweep_exception);
+    EXPECT_THROW(load("N_size_vec = [0]\n"), task::sweep_exception);
+    EXPECT_THROW(load("N_size_vec = [11]\n"), task::sweep_exception);
+    EXPECT_THROW(load("T_creation_vec = [0.0]\n"), task::sweep_exception);
+    EXPECT_THROW(load("T_sample_vec = [0.95, -0.5]\n"), task::sweep_exception);
+    EXPECT_THROW(load("T_sample_vec = [nan]\n"), task::sweep_exception);
+    EXPECT_THROW(load("t_wait_vec = [100, 0]\n"), task::sweep_exception);
+    EXPECT_THROW(load("t_wait_vec = [0, 0]\n"), task::sweep_exception);
+    EXPECT_THROW(load("m_stat_amount = 0\n"), task::sweep_exception);
+    EXPECT_THROW(load("j_stat_amount = 0\n"), task::sweep_exception);
+    EXPECT_THROW(load("mcs_init = 1\n"), task::sweep_exception);
+}
+
+TEST_F(sweep_test, written_sweep_reads_back_the_same)
+{
+    load("L = 128\n"
+         "N_size_vec = [3, 7]\n"
+         "T_sample_vec = [0.1, 0.3333333333333333]\n"
+         "t_wait_vec = [0, 50, 400]\n"
+         "magn_field_vec = [0.0, [0.1, 0.2, 0.3]]\n");
+    std::ostringstream first{};
+    task::writeSweep(first);
+
+    load(first.str());
+    std::ostringstream second{};
+    task::writeSweep(second);
+    EXPECT_EQ(first.str(), second.str());
+    EXPECT_EQ(base_config::L, 128);
+    EXPECT_EQ(base_config::t_wait_vec, (std::vector<unsigned>{0, 50, 400}));
+}
+
+TEST_F(sweep_test, stored_sweep_is_kept_and_checked)
+{
+    const auto dir = path.parent_path() / ("gmr_store_" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+    const auto stored_path = dir / "sweep.toml";
+
+    task::storeSweep(stored_path);
+    ASSERT_TRUE(std::filesystem::exists(stored_path));
+    // временный файл не остаётся
+    const std::filesystem::directory_iterator files{dir};
+    EXPECT_EQ(std::distance(begin(files), end(files)), 1);
+    // та же развёртка сверяется без ошибки, другая не перезаписывает файл
+    EXPECT_NO_THROW(task::storeSweep(stored_path));
+    base_config::mcs_observation++;
+    EXPECT_THROW(task::storeSweep(stored_path), task::sweep_exception);
+
+    task::loadSweep(stored_path);
+    EXPECT_NO_THROW(task::storeSweep(stored_path));
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,411 @@
+#include "thread_pool.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+// срок, за который пул обязан ответить: дольше - значит, потоки зависли
+constexpr auto timeout = 10s;
+
+// задачи ждут на gate, пока тест не откроет его
+struct gate_t {
+    std::promise<void> promise{};
+    std::shared_future<void> future = promise.get_future().share();
+
+    void open()
+    {
+        promise.set_value();
+    }
+    void wait() const
+    {
+        future.wait();
+    }
+};
+} // namespace
+
+TEST(thread_pool, runs_tasks_added_to_idle_workers)
+{
+    thread_pool_t pool{2};
+    pool.init();
+    // потоки успевают уснуть, задача должна их разбудить
+    std::this_thread::sleep_for(50ms);
+    auto future = pool.add_task([](int value) { return value * 2; }, 21);
+    ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    EXPECT_EQ(future.get(), 42);
+}
+
+TEST(thread_pool, resize_shrinks_after_running_tasks_finish)
+{
+    thread_pool_t pool{4};
+    pool.init();
+    gate_t gate{};
+    std::atomic<unsigned> started{0};
+    std::vector<std::future<void>> futures{};
+    for (auto idx = 0u; idx < 4; ++idx) {
+        futures.push_back(pool.add_task([&gate, &started]() {
+            started++;
+            gate.wait();
+        }));
+    }
+    while (started < 4) {
+        std::this_thread::yield();
+    }
+    auto resized = pool.resize(2);
+    EXPECT_EQ(pool.get_threads_amount(), 2u);
+    // лишние потоки заняты и не могут остановиться раньше своих задач
+    EXPECT_EQ(resized.wait_for(50ms), std::future_status::timeout);
+    gate.open();
+    ASSERT_EQ(resized.wait_for(timeout), std::future_status::ready);
+    for (auto& future : futures) {
+        ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    }
+    EXPECT_EQ(pool.get_workers_stats().size(), 2u);
+
+    std::atomic<unsigned> done{0};
+    std::vector<std::future<void>> after{};
+    for (auto idx = 0u; idx < 8; ++idx) {
+        after.push_back(pool.add_task([&done]() { done++; }));
+    }
+    for (auto& future : after) {
+        ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    }
+    EXPECT_EQ(done.load(), 8u);
+}
+
+TEST(thread_pool, resize_to_zero_throws)
+{
+    thread_pool_t pool{1};
+    EXPECT_THROW(pool.resize(0), std::underflow_error);
+}
+
+TEST(thread_pool, reports_busy_and_idle_time)
+{
+    thread_pool_t pool{1};
+    pool.init();
+    auto future = pool.add_task([]() { std::this_thread::sleep_for(50ms); });
+    ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    std::this_thread::sleep_for(20ms);
+
+    const auto stats = pool.get_workers_stats();
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].tasks_done, 1u);
+    EXPECT_GE(stats[0].busy, 50ms);
+    EXPECT_GE(stats[0].idle, 20ms);
+}
+
+// future брошенной задачи получает broken_promise
+static bool isDropped(std::future<void>& future)
+{
+    try {
+        future.get();
+    } catch (const std::future_error& error) {
+        return error.code() == std::future_errc::broken_promise;
+    }
+    return false;
+}
+
+TEST(thread_pool, termination_drops_queued_tasks)
+{
+    std::atomic<unsigned> done{0};
+    std::vector<std::future<void>> queued{};
+    gate_t gate{};
+    std::thread opener{};
+    {
+        thread_pool_t pool{1};
+        pool.init();
+        std::atomic<bool> started{false};
+        auto running = pool.add_task([&gate, &started]() {
+            started = true;
+            gate.wait();
+        });
+        for (auto idx = 0u; idx < 4; ++idx) {
+            queued.push_back(pool.add_task([&done]() { done++; }));
+        }
+        while (!started) {
+            std::this_thread::yield();
+        }
+        // задача отпускается, когда деструктор пула уже начал завершение
+        opener = std::thread{[&gate]() {
+            std::this_thread::sleep_for(50ms);
+            gate.open();
+        }};
+    }
+    opener.join();
+    EXPECT_EQ(done.load(), 0u);
+    for (auto& future : queued) {
+        EXPECT_TRUE(isDropped(future));
+    }
+}
+
+TEST(thread_pool, termination_drops_local_queues_in_work_stealing_mode)
+{
+    std::atomic<unsigned> done{0};
+    std::vector<std::future<void>> local{};
+    gate_t gate{};
+    gate_t pushed{};
+    std::thread opener{};
+    {
+        thread_pool_t pool{1, thread_pool_t::mode_t::work_stealing};
+        pool.init();
+        // задачи, добавленные изнутри пула, попадают в локальную очередь единственного потока
+        auto running = pool.add_task([&]() {
+            for (auto idx = 0u; idx < 4; ++idx) {
+                local.push_back(pool.add_task([&done]() { done++; }));
+            }
+            pushed.open();
+            gate.wait();
+        });
+        pushed.wait();
+        opener = std::thread{[&gate]() {
+            std::this_thread::sleep_for(50ms);
+            gate.open();
+        }};
+    }
+    opener.join();
+    EXPECT_EQ(done.load(), 0u);
+    ASSERT_EQ(local.size(), 4u);
+    for (auto& future : local) {
+        EXPECT_TRUE(isDropped(future));
+    }
+}
+
+TEST(thread_pool, idle_worker_steals_from_busy_one)
+{
+    thread_pool_t pool{2, thread_pool_t::mode_t::work_stealing};
+    pool.init();
+    auto outer = pool.add_task([&pool]() {
+        const auto owner = std::this_thread::get_id();
+        // владелец локальной очереди ждёт и сам задачу не возьмёт, её может только украсть
+        // второй поток
+        auto inner = pool.add_task([]() { return std::this_thread::get_id(); });
+        if (inner.wait_for(timeout) != std::future_status::ready) {
+            return false;
+        }
+        return inner.get() != owner;
+    });
+    ASSERT_EQ(outer.wait_for(2 * timeout), std::future_status::ready);
+    EXPECT_TRUE(outer.get());
+}
+
+TEST(thread_pool, work_stealing_runs_external_and_internal_tasks)
+{
+    thread_pool_t pool{4, thread_pool_t::mode_t::work_stealing};
+    pool.init();
+    std::atomic<unsigned> done{0};
+    std::vector<std::future<void>> futures{};
+    for (auto idx = 0u; idx < 16; ++idx) {
+        futures.push_back(pool.add_task([&pool, &done]() {
+            for (auto jdx = 0u; jdx < 16; ++jdx) {
+                pool.add_task([&done]() { done++; });
+            }
+        }));
+    }
+    for (auto& future : futures) {
+        ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (done < 16 * 16 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(done.load(), 16u * 16u);
+}
+
+TEST(thread_pool, parallel_for_outside_pool_runs_in_order)
+{
+    std::vector<std::size_t> order{};
+    thread_pool_t::parallel_for(5, [&order](std::size_t idx) { order.push_back(idx); });
+    EXPECT_EQ(order, (std::vector<std::size_t>{0, 1, 2, 3, 4}));
+}
+
+TEST(thread_pool, nested_parallel_for_does_not_deadlock)
+{
+    for (const auto mode :
+         {thread_pool_t::mode_t::shared_queue, thread_pool_t::mode_t::work_stealing}) {
+        thread_pool_t pool{2, mode};
+        pool.init();
+        std::atomic<std::size_t> sum{0};
+        std::vector<std::future<void>> futures{};
+        // задач больше, чем потоков, и каждая ждёт свои подзадачи, которые ждут свои
+        for (auto task = 0u; task < 6; ++task) {
+            futures.push_back(pool.add_task([&sum]() {
+                thread_pool_t::parallel_for(20, [&sum](std::size_t outer) {
+                    thread_pool_t::parallel_for(
+                        10, [&sum, outer](std::size_t inner) { sum += outer * 10 + inner; });
+                });
+            }));
+        }
+        for (auto& future : futures) {
+            ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+            future.get();
+        }
+        // сумма 0..199 на каждую задачу
+        EXPECT_EQ(sum.load(), 6u * 199u * 200u / 2u);
+    }
+}
+
+TEST(thread_pool, parallel_for_rethrows_after_all_iterations)
+{
+    thread_pool_t pool{2};
+    pool.init();
+    std::atomic<unsigned> done{0};
+    auto future = pool.add_task([&done]() {
+        thread_pool_t::parallel_for(50, [&done](std::size_t idx) {
+            done++;
+            if (idx == 7) {
+                throw std::runtime_error{"iteration 7"};
+            }
+        });
+    });
+    ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    EXPECT_THROW(future.get(), std::runtime_error);
+    // исключение обрывает только свой кусок итераций, остальные куски доходят до конца
+    EXPECT_GE(done.load(), 8u);
+    EXPECT_LT(done.load(), 50u);
+}
+
+TEST(completion_queue, hands_back_tasks_in_order_of_completion)
+{
+    thread_pool_t pool{2};
+    pool.init();
+    completion_queue_t<int> queue{};
+    gate_t gate{};
+    pool.add_task(queue, {}, [&gate]() {
+        gate.wait();
+        return 1;
+    });
+    pool.add_task(queue, {}, []() { return 2; });
+
+    auto first = queue.pop_for(timeout);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first->get(), 2);
+    // первая задача ещё ждёт, очередь пуста
+    EXPECT_FALSE(queue.pop_for(20ms));
+    EXPECT_EQ(queue.size(), 0u);
+
+    gate.open();
+    auto second = queue.pop_for(timeout);
+    ASSERT_TRUE(second);
+    EXPECT_EQ(second->get(), 1);
+}
+
+TEST(completion_queue, hands_back_exceptions)
+{
+    thread_pool_t pool{1};
+    pool.init();
+    completion_queue_t<void> queue{};
+    pool.add_task(queue, {}, []() { throw std::runtime_error{"failed"}; });
+    auto future = queue.pop_for(timeout);
+    ASSERT_TRUE(future);
+    EXPECT_THROW(future->get(), std::runtime_error);
+}
+
+TEST(cancellation_token, cancelled_before_start_task_does_not_run)
+{
+    thread_pool_t pool{1};
+    pool.init();
+    thread_pool_t::task_info_t info{};
+    info.token = cancellation_token_t::create();
+    info.token.cancel();
+    std::atomic<bool> is_run{false};
+    auto future = pool.add_task(info, [&is_run]() { is_run = true; });
+    ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    EXPECT_THROW(future.get(), task_cancelled);
+    EXPECT_FALSE(is_run);
+}
+
+TEST(cancellation_token, cancelled_before_start_task_reaches_completion_queue)
+{
+    thread_pool_t pool{1};
+    pool.init();
+    completion_queue_t<int> queue{};
+    thread_pool_t::task_info_t info{};
+    info.token = cancellation_token_t::create();
+    info.token.cancel();
+    pool.add_task(queue, info, []() { return 1; });
+    auto future = queue.pop_for(timeout);
+    ASSERT_TRUE(future);
+    EXPECT_THROW(future->get(), task_cancelled);
+}
+
+TEST(cancellation_token, follows_parent_and_deadline)
+{
+    const cancellation_token_t empty{};
+    EXPECT_FALSE(empty.is_cancelled());
+    empty.cancel();
+    EXPECT_FALSE(empty.is_cancelled());
+
+    const auto parent = cancellation_token_t::create();
+    const auto child = cancellation_token_t::create(parent);
+    EXPECT_FALSE(child.is_cancelled());
+    parent.cancel();
+    EXPECT_TRUE(child.is_cancelled());
+    EXPECT_THROW(child.throw_if_cancelled("child"), task_cancelled);
+
+    const auto expired = cancellation_token_t::create({}, std::chrono::steady_clock::now() - 1ms);
+    EXPECT_TRUE(expired.is_cancelled());
+}
+
+TEST(thread_pool, defers_tasks_over_memory_budget)
+{
+    thread_pool_t pool{2};
+    std::vector<std::string> log{};
+    pool.set_memory_budget(100, [&log](const std::string& message) { log.push_back(message); });
+    pool.init();
+
+    gate_t gate{};
+    std::atomic<bool> is_first_started{false};
+    std::atomic<bool> is_second_started{false};
+    thread_pool_t::task_info_t first{};
+    first.memory = 80;
+    first.label = "first";
+    auto first_future = pool.add_task(first, [&]() {
+        is_first_started = true;
+        gate.wait();
+    });
+    while (!is_first_started) {
+        std::this_thread::yield();
+    }
+    thread_pool_t::task_info_t second = first;
+    second.label = "second";
+    auto second_future = pool.add_task(second, [&]() { is_second_started = true; });
+
+    // свободный поток есть, но вторая задача не помещается в бюджет рядом с первой
+    std::this_thread::sleep_for(50ms);
+    EXPECT_FALSE(is_second_started);
+
+    gate.open();
+    ASSERT_EQ(first_future.wait_for(timeout), std::future_status::ready);
+    ASSERT_EQ(second_future.wait_for(timeout), std::future_status::ready);
+    EXPECT_TRUE(is_second_started);
+
+    // журнал пишется под mutex пула, к этому моменту все записи уже сделаны
+    auto has_entry = [&log](const std::string& prefix) {
+        return std::any_of(log.begin(), log.end(), [&prefix](const std::string& message) {
+            return message.rfind(prefix, 0) == 0;
+        });
+    };
+    EXPECT_TRUE(has_entry("admitted first"));
+    EXPECT_TRUE(has_entry("deferred second"));
+    EXPECT_TRUE(has_entry("admitted second"));
+}
+
+TEST(thread_pool, runs_task_larger_than_budget_alone)
+{
+    thread_pool_t pool{2};
+    pool.set_memory_budget(100);
+    pool.init();
+    thread_pool_t::task_info_t info{};
+    info.memory = 1000;
+    auto future = pool.add_task(info, []() { return 1; });
+    ASSERT_EQ(future.wait_for(timeout), std::future_status::ready);
+    EXPECT_EQ(future.get(), 1);
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+# Локальная проверка общей очереди (--queue): несколько процессов main на одной машине разбирают
+# одну развёртку во временной папке. Для сравнения та же развёртка считается статическим
+# разбиением --shard i/n с тем же числом процессов. Разная скорость узлов задаётся разным числом
+# потоков у процессов.
+#
+#   tools/queue_local.sh <main> <sweep file> [threads of each process ...]
+#
+# например tools/queue_local.sh build/src/main sweep.toml 4 1 1
+# Если рядом с main лежит stat, время долей включает stat --merge: процесс очереди тоже считает
+# статистику сам. Процесс, чьи оставшиеся конфигурации считают другие, перепроверяет их раз
+# в lease-timeout / 4 (не чаще раза в секунду), поэтому на развёртке из секундных конфигураций
+# очередь проигрывает долям. KEEP=1 оставляет временную папку.
+set -euo pipefail
+
+if [ $# -lt 2 ]; then
+    sed -n '2,13p' "$0"
+    exit 1
+fi
+main=$(realpath -s "$1")
+sweep=$(realpath "$2")
+shift 2
+threads=("$@")
+if [ ${#threads[@]} -eq 0 ]; then
+    threads=(2 1)
+fi
+amount=${#threads[@]}
+stat="$(dirname "$main")/stat"
+work=$(mktemp -d)
+echo "work folder : $work"
+
+now() {
+    date +%s.%N
+}
+
+since() {
+    awk -v start="$1" -v end="$(now)" 'BEGIN { print end - start }'
+}
+
+# запускает процессы в фоне и ждёт всех, код возврата - ненулевой, если упал хоть один
+wait_all() {
+    local status=0
+    for pid in "$@"; do
+        wait "$pid" || status=1
+    done
+    return $status
+}
+
+pids=()
+start=$(now)
+for idx in "${!threads[@]}"; do
+    mkdir -p "$work/queue_$idx"
+    (cd "$work/queue_$idx" \
+        && "$main" --queue "$work/data" --sweep "$sweep" --threads "${threads[$idx]}" \
+            --lease-timeout 10 >log.txt 2>&1) &
+    pids+=($!)
+done
+if ! wait_all "${pids[@]}"; then
+    echo "queue : a process failed, see $work/queue_*/log.txt"
+    exit 1
+fi
+queue_time=$(since "$start")
+if [ ! -e "$work/data/queue/done/stat" ]; then
+    echo "queue : statistics were not calculated, see $work/queue_*/log.txt"
+    exit 1
+fi
+for idx in "${!threads[@]}"; do
+    echo "queue process $idx (${threads[$idx]} threads) : $(grep -c -- '--- done' "$work/queue_$idx/log.txt") configs"
+done
+
+pids=()
+start=$(now)
+for idx in "${!threads[@]}"; do
+    mkdir -p "$work/shard_$idx"
+    (cd "$work/shard_$idx" \
+        && "$main" --shard "$idx/$amount" --sweep "$sweep" --threads "${threads[$idx]}" \
+            >log.txt 2>&1) &
+    pids+=($!)
+done
+if ! wait_all "${pids[@]}"; then
+    echo "shards : a process failed, see $work/shard_*/log.txt"
+    exit 1
+fi
+if [ -x "$stat" ]; then
+    (cd "$work" && "$stat" --merge "$work"/shard_*/results/data_* >merge_log.txt 2>&1)
+fi
+shard_time=$(since "$start")
+
+echo "queue : $queue_time s, static shards : $shard_time s"
+if [ "${KEEP:-0}" != "1" ]; then
+    rm -rf "$work"
+fi